@@ -0,0 +1,494 @@
+#ifndef __ARRIVAL_MONITOR_H__
+#define __ARRIVAL_MONITOR_H__
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Arrivals of the participants in a phase, i.e., a syncThreads() of a barrier or
+ * a round of notify() calls to a fan-in.
+ */
+struct PhaseReport {
+
+    uint64_t           m_phase;           // 1, 2, ...
+    bool               m_completed;       // false if reported by the watchdog while the phase is still open
+    uint64_t           m_spread_ns;       // last arrival - first arrival. Now - first arrival if not completed.
+    int                m_last_thread_id;  // the last arriver. -1 if not completed.
+    vector< int >      m_arrival_order;   // thread_ids from the first to the last arriver
+    vector< uint64_t > m_lags_ns;         // [ thread_id ] arrival - first arrival. UINT64_MAX if not arrived.
+    vector< int >      m_missing;         // thread_ids not arrived yet. Empty if completed.
+
+    PhaseReport()
+        :m_phase          ( 0 )
+        ,m_completed      ( false )
+        ,m_spread_ns      ( 0 )
+        ,m_last_thread_id ( -1 )
+        {;}
+
+    string summary() const {
+
+        stringstream ss;
+        ss << "phase " << m_phase << ( m_completed ? "" : " (open)" )
+           << " spread: " << m_spread_ns << " [ns]";
+        if ( m_last_thread_id >= 0 ) {
+            ss << " last: " << m_last_thread_id;
+        }
+        if ( !m_missing.empty() ) {
+            ss << " missing:";
+            for ( const auto id : m_missing ) {
+                ss << " " << id;
+            }
+        }
+        return ss.str();
+    }
+};
+
+
+/**
+ * Straggler & stall detector for a barrier or a fan-in with thread_ids.
+ * It is attached to a synchronizer with setArrivalMonitor(), and then each participant
+ * calls arrive() as it enters the phase, and the thread that releases the others calls
+ * completePhase(). See setArrivalMonitor() in thread_synchronizer.h.
+ *
+ * arrive() is one timestamp and two stores on the thread's own cache line.
+ * completePhase() runs on the critical path of the release and is O(N), so it is meant
+ * for the diagnosis and not for the production runs.
+ *
+ * At each completed phase it updates per thread_id the number of times it was the last,
+ * and the mean & max lag behind the first arriver, and it adds the lags to a log2 histogram.
+ * A phase whose spread exceeds the threshold is kept as a PhaseReport with the arrival order.
+ * The optional watchdog thread reports a phase that has been open longer than the threshold
+ * with the thread_ids that have not arrived yet, so a stall can be seen while it is happening.
+ * Such a phase is reported again when it completes, and the final report replaces the open one.
+ *
+ * The participants must not arrive at the next phase before the phase is completed.
+ * It holds for the barriers, and for the fan-in of a fork-join.
+ */
+class ArrivalMonitor {
+
+    static constexpr int NUM_BUCKETS = 64;
+
+    struct Arrival {
+        atomic< uint64_t > m_phase;   // the last phase this thread arrived at
+        atomic< uint64_t > m_time_ns;
+    };
+
+    // This header does not depend on thread_synchronizer.h, and hence not on CacheLineAligned.
+    struct alignas( 64 ) Slot {
+        Arrival m_value;
+    };
+
+    vector< Slot >         m_arrivals;  // [ thread_id ]
+
+    const int              m_num_participants;
+    atomic_int             m_num_active;     // thread_ids 0 ... m_num_active - 1 are expected to arrive.
+    const uint64_t         m_threshold_ns;
+    const size_t           m_max_reports;
+
+    atomic< uint64_t >     m_num_phases;     // completed
+
+    mutex                  m_mutex;          // for the statistics below
+    vector< uint64_t >     m_num_last;       // [ thread_id ]
+    vector< uint64_t >     m_num_arrived;    // [ thread_id ] phases arrived at since reset()
+    vector< uint64_t >     m_total_lag_ns;   // [ thread_id ]
+    vector< uint64_t >     m_max_lag_ns;     // [ thread_id ]
+    vector< uint64_t >     m_lag_histogram;  // [ log2 bucket ]
+    vector< PhaseReport >  m_stalled;
+    PhaseReport            m_last_phase;
+    uint64_t               m_reported_open_phase;
+
+    function< void( const PhaseReport& ) > m_stall_handler;
+
+    thread                 m_watchdog;
+    mutex                  m_watchdog_mutex;
+    condition_variable     m_watchdog_cond_var;
+    bool                   m_watchdog_running;
+
+    static inline uint64_t now() {
+        return chrono::duration_cast< chrono::nanoseconds >( chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    static int bucket( const uint64_t ns ) {
+
+        int b = 0;
+        while ( b < NUM_BUCKETS - 1 && ( ns >> ( b + 1 ) ) != 0 ) {
+            b++;
+        }
+        return b;
+    }
+
+    /**
+     * @brief fills the report from the arrivals at the phase.
+     *
+     * @return the first arrival time.
+     */
+    uint64_t fillReport( PhaseReport& report, const uint64_t phase ) {
+
+        report.m_phase = phase;
+        report.m_lags_ns.assign( m_num_participants, UINT64_MAX );
+
+        vector< pair< uint64_t, int > > arrived;
+
+        const int num_active = m_num_active.load( memory_order_acquire );
+
+        for ( int i = 0; i < num_active; i++ ) {
+            auto& a = m_arrivals[i].m_value;
+            if ( a.m_phase.load( memory_order_acquire ) >= phase ) {
+                arrived.emplace_back( a.m_time_ns.load( memory_order_relaxed ), i );
+            }
+            else {
+                report.m_missing.push_back( i );
+            }
+        }
+        sort( arrived.begin(), arrived.end() );
+
+        const uint64_t first = arrived.empty() ? now() : arrived.front().first;
+
+        for ( const auto& a : arrived ) {
+            report.m_arrival_order.push_back( a.second );
+            report.m_lags_ns[ a.second ] = a.first - first;
+        }
+        return first;
+    }
+
+    /**
+     * @brief keeps the report. Called with m_mutex held. The caller invokes the handler
+     *        with reportStall() after releasing m_mutex, so that the handler can call the accessors.
+     */
+    void addStall( const PhaseReport& report ) {
+
+        if ( m_stalled.size() < m_max_reports ) {
+            m_stalled.push_back( report );
+        }
+    }
+
+    void reportStall( const PhaseReport& report ) {
+
+        if ( m_stall_handler ) {
+            m_stall_handler( report );
+        }
+    }
+
+    void checkOpenPhase() {
+
+        PhaseReport report;
+        {
+            lock_guard< mutex > lock( m_mutex );
+
+            const uint64_t phase = m_num_phases.load( memory_order_acquire ) + 1;
+
+            if ( phase == m_reported_open_phase ) {
+                return;
+            }
+            const uint64_t first = fillReport( report, phase );
+
+            if ( report.m_arrival_order.empty() || report.m_missing.empty() ) {
+                return;
+            }
+            const uint64_t t = now();
+            report.m_spread_ns = ( t > first ) ? t - first : 0;
+
+            if ( report.m_spread_ns <= m_threshold_ns ) {
+                return;
+            }
+            m_reported_open_phase = phase;
+            addStall( report );
+        }
+        reportStall( report );
+    }
+
+  public:
+
+    /**
+     * @param num_participants (in): number of the threads that arrive in each phase.
+     * @param threshold        (in): a phase with a longer spread between the first and the last arrival is reported.
+     * @param max_reports      (in): max number of the reports kept for stalledPhases().
+     */
+    ArrivalMonitor( const int                 num_participants,
+                    const chrono::nanoseconds threshold   = chrono::milliseconds( 1 ),
+                    const size_t              max_reports = 256 )
+        :m_arrivals            ( num_participants )
+        ,m_num_participants    ( num_participants )
+        ,m_num_active          ( num_participants )
+        ,m_threshold_ns        ( threshold.count() )
+        ,m_max_reports         ( max_reports )
+        ,m_num_phases          ( 0 )
+        ,m_reported_open_phase ( 0 )
+        ,m_watchdog_running    ( false )
+    {
+        for ( auto& a : m_arrivals ) {
+            a.m_value.m_phase.  store( 0, memory_order_relaxed );
+            a.m_value.m_time_ns.store( 0, memory_order_relaxed );
+        }
+        reset();
+    }
+
+    ~ArrivalMonitor() {
+        stopWatchdog();
+    }
+
+    int numParticipants() const { return m_num_participants; }
+
+    /**
+     * @brief changes the number of the participants expected in each phase.
+     *        Called by setNumActive() of the synchronizer it is attached to.
+     *
+     * @param num_active (in): 1 <= num_active <= numParticipants(). Clamped to this range.
+     */
+    void setNumActive( const int num_active ) {
+        m_num_active.store( min( max( num_active, 1 ), m_num_participants ), memory_order_release );
+    }
+
+    /**
+     * @brief records the arrival of the thread at the current phase. Called by the synchronizer.
+     *        It stores the global phase rather than counting its own arrivals, so that a thread
+     *        that has been inactive for some phases is up to date as soon as it arrives again.
+     */
+    inline void arrive( const int thread_id ) {
+
+        auto& a = m_arrivals[ thread_id ].m_value;
+        a.m_time_ns.store( now(), memory_order_relaxed );
+        a.m_phase.  store( m_num_phases.load( memory_order_acquire ) + 1, memory_order_release );
+    }
+
+    /**
+     * @brief closes the current phase and updates the statistics.
+     *        Called by the synchronizer on the thread that releases the others, before the release.
+     */
+    void completePhase() {
+
+        PhaseReport report;
+        bool        stalled = false;
+        {
+            lock_guard< mutex > lock( m_mutex );
+
+            const uint64_t phase = m_num_phases.load( memory_order_relaxed ) + 1;
+
+            fillReport( report, phase );
+
+            report.m_completed = true;
+            if ( !report.m_arrival_order.empty() ) {
+                report.m_last_thread_id = report.m_arrival_order.back();
+                report.m_spread_ns      = report.m_lags_ns[ report.m_last_thread_id ];
+            }
+            for ( int i = 0; i < m_num_participants; i++ ) {
+                const uint64_t lag = report.m_lags_ns[i];
+                if ( lag != UINT64_MAX ) {
+                    m_num_arrived[i]++;
+                    m_total_lag_ns[i] += lag;
+                    m_max_lag_ns[i]    = max( m_max_lag_ns[i], lag );
+                    m_lag_histogram[ bucket( lag ) ]++;
+                }
+            }
+            if ( report.m_last_thread_id >= 0 ) {
+                m_num_last[ report.m_last_thread_id ]++;
+            }
+            if ( phase == m_reported_open_phase && !m_stalled.empty() && m_stalled.back().m_phase == phase ) {
+                // replaces the report of the watchdog with the final one.
+                m_stalled.pop_back();
+                addStall( report );
+                stalled = true;
+            }
+            else if ( report.m_spread_ns > m_threshold_ns ) {
+                addStall( report );
+                stalled = true;
+            }
+            m_last_phase = report;
+
+            m_num_phases.store( phase, memory_order_release );
+        }
+        if ( stalled ) {
+            reportStall( report );
+        }
+    }
+
+    /**
+     * @brief called with the report of each phase over the threshold, on the thread that
+     *        completes the phase or on the watchdog thread. Set it before the threads start.
+     *        It is called without the internal lock held, so it may call the accessors.
+     */
+    void setStallHandler( function< void( const PhaseReport& ) > handler ) {
+        m_stall_handler = move( handler );
+    }
+
+    /**
+     * @brief starts a thread that checks the open phase periodically, and reports it
+     *        with the missing thread_ids if it has been open longer than the threshold.
+     */
+    void startWatchdog( const chrono::milliseconds interval = chrono::milliseconds( 10 ) ) {
+
+        lock_guard< mutex > lock( m_watchdog_mutex );
+        if ( m_watchdog_running ) {
+            return;
+        }
+        m_watchdog_running = true;
+
+        m_watchdog = thread( [this, interval] {
+
+            unique_lock< mutex > lock( m_watchdog_mutex );
+            while ( m_watchdog_running ) {
+                m_watchdog_cond_var.wait_for( lock, interval );
+                checkOpenPhase();
+            }
+        } );
+    }
+
+    void stopWatchdog() {
+
+        {
+            lock_guard< mutex > lock( m_watchdog_mutex );
+            if ( !m_watchdog_running ) {
+                return;
+            }
+            m_watchdog_running = false;
+        }
+        m_watchdog_cond_var.notify_one();
+        m_watchdog.join();
+    }
+
+    uint64_t numPhases() const { return m_num_phases.load( memory_order_acquire ); }
+
+    /**
+     * @brief the report of the last completed phase.
+     */
+    PhaseReport lastPhase() {
+        lock_guard< mutex > lock( m_mutex );
+        return m_last_phase;
+    }
+
+    /**
+     * @brief the phases over the threshold, completed or reported by the watchdog, in the order of the detection.
+     */
+    vector< PhaseReport > stalledPhases() {
+        lock_guard< mutex > lock( m_mutex );
+        return m_stalled;
+    }
+
+    /**
+     * @brief [ thread_id ] number of the phases in which the thread was the last to arrive.
+     */
+    vector< uint64_t > numTimesLast() {
+        lock_guard< mutex > lock( m_mutex );
+        return m_num_last;
+    }
+
+    /**
+     * @brief [ thread_id ] mean lag behind the first arriver in nanoseconds,
+     *        over the phases the thread arrived at since the last reset().
+     */
+    vector< uint64_t > meanLagNs() {
+
+        lock_guard< mutex > lock( m_mutex );
+        vector< uint64_t > mean( m_num_participants, 0 );
+        for ( int i = 0; i < m_num_participants; i++ ) {
+            if ( m_num_arrived[i] > 0 ) {
+                mean[i] = m_total_lag_ns[i] / m_num_arrived[i];
+            }
+        }
+        return mean;
+    }
+
+    /**
+     * @brief [ thread_id ] max lag behind the first arriver in nanoseconds.
+     */
+    vector< uint64_t > maxLagNs() {
+        lock_guard< mutex > lock( m_mutex );
+        return m_max_lag_ns;
+    }
+
+    /**
+     * @brief the lag distribution over all the threads and phases.
+     *        Bucket 0 counts the lags in [0, 2) ns, and bucket k > 0 in [2^k, 2^(k+1)) ns.
+     */
+    vector< uint64_t > lagHistogram() {
+        lock_guard< mutex > lock( m_mutex );
+        return m_lag_histogram;
+    }
+
+    /**
+     * @brief the upper bound of the bucket that contains the given percentile of the lags.
+     *
+     * @param percentile (in): 0.0 - 100.0
+     */
+    uint64_t lagAtPercentile( const double percentile ) {
+
+        const auto hist  = lagHistogram();
+        uint64_t   total = 0;
+        for ( const auto c : hist ) {
+            total += c;
+        }
+        const double target = total * percentile / 100.0;
+        uint64_t     sum    = 0;
+        for ( int b = 0; b < NUM_BUCKETS; b++ ) {
+            sum += hist[b];
+            if ( total > 0 && sum >= target ) {
+                return ( b == NUM_BUCKETS - 1 ) ? UINT64_MAX : ( (uint64_t)2 << b ) - 1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief clears the statistics and the reports. The phase count is kept.
+     */
+    void reset() {
+
+        lock_guard< mutex > lock( m_mutex );
+        m_num_last.     assign( m_num_participants, 0 );
+        m_num_arrived.  assign( m_num_participants, 0 );
+        m_total_lag_ns. assign( m_num_participants, 0 );
+        m_max_lag_ns.   assign( m_num_participants, 0 );
+        m_lag_histogram.assign( NUM_BUCKETS, 0 );
+        m_stalled.clear();
+        m_last_phase = PhaseReport();
+    }
+
+    /**
+     * @brief human-readable summary: the lag percentiles, the most frequent last arrivers, and the stalled phases.
+     */
+    string summary() {
+
+        stringstream ss;
+
+        ss << "phases: " << numPhases()
+           << " lag p50: <" << lagAtPercentile( 50.0 )
+           << " p99: <"     << lagAtPercentile( 99.0 )
+           << " p99.9: <"   << lagAtPercentile( 99.9 ) << " [ns]\n";
+
+        const auto num_last = numTimesLast();
+        const auto max_lag  = maxLagNs();
+
+        vector< int > ids( m_num_participants );
+        for ( int i = 0; i < m_num_participants; i++ ) {
+            ids[i] = i;
+        }
+        sort( ids.begin(), ids.end(), [&]( const int a, const int b ) { return num_last[a] > num_last[b]; } );
+
+        ss << "last arrivers:";
+        for ( int i = 0; i < min( 5, m_num_participants ); i++ ) {
+            if ( num_last[ ids[i] ] > 0 ) {
+                ss << " " << ids[i] << " (" << num_last[ ids[i] ] << " times, max lag " << max_lag[ ids[i] ] << " [ns])";
+            }
+        }
+        ss << "\n";
+
+        const auto stalled = stalledPhases();
+        ss << "phases over the threshold: " << stalled.size() << "\n";
+        for ( const auto& r : stalled ) {
+            ss << "  " << r.summary() << "\n";
+        }
+        return ss.str();
+    }
+};
+
+#endif /*__ARRIVAL_MONITOR_H__*/
@@ -0,0 +1,28 @@
+#ifndef __CACHE_LINE_H__
+#define __CACHE_LINE_H__
+#include <new>
+
+using namespace std;
+
+// GCC warns on any use of hardware_destructive_interference_size in a header.
+#ifndef THREAD_SYNCHRONIZER_CACHE_LINE_SIZE
+#if defined(__cpp_lib_hardware_interference_size) && ( defined(__clang__) || !defined(__GNUC__) )
+#define THREAD_SYNCHRONIZER_CACHE_LINE_SIZE hardware_destructive_interference_size
+#elif defined(__APPLE__) && defined(__aarch64__)
+#define THREAD_SYNCHRONIZER_CACHE_LINE_SIZE 128
+#else
+#define THREAD_SYNCHRONIZER_CACHE_LINE_SIZE 64
+#endif
+#endif
+
+
+/**
+ * A value on its own cache line(s) to avoid false sharing.
+ * It is used for the per-thread flags in a contiguous array and for the shared counters.
+ */
+template< class T >
+struct alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) CacheLineAligned {
+    T m_value;
+};
+
+#endif /*__CACHE_LINE_H__*/
@@ -0,0 +1,400 @@
+#ifndef __CPU_TOPOLOGY_H__
+#define __CPU_TOPOLOGY_H__
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+/**
+ * Discovery of the CPU topology (NUMA nodes, packages, cores, SMT siblings, and L2/L3 sharing)
+ * from the sysfs on Linux, and placement of the threads onto the CPUs.
+ * On the other systems, and if the sysfs is not readable, all the CPUs are
+ * considered to be separate cores in a single node, and the threads are not pinned.
+ */
+
+
+/**
+ * @brief parses a CPU list in the sysfs format such as "0-3,8-11".
+ *
+ * @param list (in): the list in text.
+ *
+ * @return the CPU numbers in the list.
+ */
+static inline vector<int> parseCpuList( const string& list ) {
+
+    vector<int>  cpus;
+    stringstream ss( list );
+    string       range;
+
+    while ( getline( ss, range, ',' ) ) {
+
+        if ( range.empty() || range[0] == '\n' ) {
+            continue;
+        }
+        const auto dash = range.find( '-' );
+        try {
+            if ( dash == string::npos ) {
+                cpus.push_back( stoi( range ) );
+            }
+            else {
+                const int first = stoi( range.substr( 0, dash ) );
+                const int last  = stoi( range.substr( dash + 1 ) );
+                for ( int c = first; c <= last; c++ ) {
+                    cpus.push_back( c );
+                }
+            }
+        }
+        catch ( const exception& ) {
+            return vector<int>();
+        }
+    }
+    return cpus;
+}
+
+
+/**
+ * @brief reads the first line of a sysfs file.
+ *
+ * @return the line, or an empty string if the file can't be read.
+ */
+static inline string readSysfsLine( const string& path ) {
+
+    ifstream ifs( path );
+    string   line;
+
+    if ( ifs.is_open() ) {
+        getline( ifs, line );
+    }
+    return line;
+}
+
+
+/**
+ * @brief finds the NUMA node of each logical CPU in /sys/devices/system/node.
+ *
+ * @return the node number indexed by the CPU number. Empty if not available.
+ */
+static inline vector<int> numaNodesOfCpus() {
+
+    vector<int> nodes_of_cpus;
+
+    const auto nodes = parseCpuList( readSysfsLine( "/sys/devices/system/node/online" ) );
+
+    for ( const auto node : nodes ) {
+
+        const auto cpus = parseCpuList( readSysfsLine(
+                              "/sys/devices/system/node/node" + to_string( node ) + "/cpulist" ) );
+
+        for ( const auto cpu : cpus ) {
+            if ( cpu >= (int)nodes_of_cpus.size() ) {
+                nodes_of_cpus.resize( cpu + 1, -1 );
+            }
+            nodes_of_cpus[ cpu ] = node;
+        }
+    }
+    for ( auto& n : nodes_of_cpus ) {
+        if ( n == -1 ) {
+            n = 0; // offline CPU
+        }
+    }
+    return nodes_of_cpus;
+}
+
+
+/**
+ * @brief assigns each thread to the NUMA node of the CPU it is expected to run on.
+ *        It assumes the compact placement, i.e., thread i runs on CPU (i mod #CPUs).
+ *
+ * @param num_threads (in): number of the threads in the group.
+ *
+ * @return the node number indexed by thread_id. All zero if the nodes are not available.
+ */
+static inline vector<int> numaGroupsForThreads( const int num_threads ) {
+
+    const auto nodes_of_cpus = numaNodesOfCpus();
+
+    vector<int> groups( num_threads, 0 );
+
+    if ( !nodes_of_cpus.empty() ) {
+        for ( int i = 0; i < num_threads; i++ ) {
+            groups[i] = nodes_of_cpus[ i % nodes_of_cpus.size() ];
+        }
+    }
+    return groups;
+}
+
+
+/**
+ * How the threads of a group are placed onto the CPUs.
+ *
+ * NONE:         not pinned. The OS decides.
+ * COMPACT:      fills the CPUs in the order of node, package, L3, core, and SMT sibling,
+ *               i.e., the neighboring threads share the core and the caches.
+ * SCATTER:      spreads the threads across the nodes first, and then across the cores.
+ *               The SMT siblings are used only after all the cores have got a thread.
+ * ONE_PER_CORE: like COMPACT but only the first SMT sibling of each core is used.
+ *
+ * If the threads outnumber the CPUs for the policy, they wrap around.
+ */
+enum class CpuPlacement { NONE, COMPACT, SCATTER, ONE_PER_CORE };
+
+
+/**
+ * Position of a logical CPU in the topology.
+ * The L2 and L3 ids are the lowest CPU number that shares the cache, or -1 if unknown.
+ */
+struct CpuInfo {
+    int m_cpu;
+    int m_node;
+    int m_package;
+    int m_core;
+    int m_smt_index;    // 0 for the first SMT sibling of the core
+    int m_l2;
+    int m_l3;
+};
+
+
+/**
+ * Topology of the online CPUs, and the placement policies on it.
+ */
+class CpuTopology {
+
+    vector< CpuInfo > m_cpus;
+
+    static int readSysfsInt( const string& path, const int default_value ) {
+
+        const auto line = readSysfsLine( path );
+        try {
+            return line.empty() ? default_value : stoi( line );
+        }
+        catch ( const exception& ) {
+            return default_value;
+        }
+    }
+
+    /**
+     * @brief the lowest CPU that shares the cache of the given level with cpu, or -1.
+     */
+    static int sharedCacheId( const int cpu, const int level ) {
+
+        const string dir = "/sys/devices/system/cpu/cpu" + to_string( cpu ) + "/cache/";
+
+        for ( int index = 0; index < 8; index++ ) {
+
+            const string index_dir = dir + "index" + to_string( index ) + "/";
+            const int    l         = readSysfsInt( index_dir + "level", -1 );
+
+            if ( l == -1 ) {
+                break;
+            }
+            const auto type = readSysfsLine( index_dir + "type" );
+            if ( l == level && type != "Instruction" ) {
+                const auto shared = parseCpuList( readSysfsLine( index_dir + "shared_cpu_list" ) );
+                return shared.empty() ? -1 : *min_element( shared.begin(), shared.end() );
+            }
+        }
+        return -1;
+    }
+
+  public:
+
+    /**
+     * @brief reads the topology of the online CPUs from /sys/devices/system/cpu.
+     */
+    CpuTopology() {
+
+        auto cpus = parseCpuList( readSysfsLine( "/sys/devices/system/cpu/online" ) );
+
+        if ( cpus.empty() ) {
+            const int n = max( 1, (int)thread::hardware_concurrency() );
+            for ( int i = 0; i < n; i++ ) {
+                cpus.push_back( i );
+            }
+        }
+        const auto nodes_of_cpus = numaNodesOfCpus();
+
+        for ( const auto cpu : cpus ) {
+
+            const string topology = "/sys/devices/system/cpu/cpu" + to_string( cpu ) + "/topology/";
+
+            CpuInfo info;
+            info.m_cpu       = cpu;
+            info.m_node      = cpu < (int)nodes_of_cpus.size() ? nodes_of_cpus[ cpu ] : 0;
+            info.m_package   = readSysfsInt( topology + "physical_package_id", 0 );
+            info.m_core      = readSysfsInt( topology + "core_id", cpu );
+            info.m_l2        = sharedCacheId( cpu, 2 );
+            info.m_l3        = sharedCacheId( cpu, 3 );
+
+            const auto siblings = parseCpuList( readSysfsLine( topology + "thread_siblings_list" ) );
+            const auto it       = find( siblings.begin(), siblings.end(), cpu );
+            info.m_smt_index    = it == siblings.end() ? 0 : (int)( it - siblings.begin() );
+
+            m_cpus.push_back( info );
+        }
+    }
+
+    /**
+     * @brief the topology given by the caller, e.g. for a machine other than this one.
+     */
+    CpuTopology( const vector< CpuInfo >& cpus ) : m_cpus( cpus ) {;}
+
+    const vector< CpuInfo >& cpus() const { return m_cpus; }
+
+    int numCpus() const { return m_cpus.size(); }
+
+    int numCores() const {
+        return count_if( m_cpus.begin(), m_cpus.end(), []( const CpuInfo& c ) { return c.m_smt_index == 0; } );
+    }
+
+    int numNodes() const {
+
+        int n = 0;
+        for ( const auto& c : m_cpus ) {
+            n = max( n, c.m_node + 1 );
+        }
+        return n;
+    }
+
+    /**
+     * @brief the CPU for each thread under the placement policy.
+     *
+     * @param placement   (in): the policy.
+     * @param num_threads (in): number of the threads in the group.
+     *
+     * @return the CPU number indexed by thread_id. -1 for not pinned.
+     */
+    vector< int > placement( const CpuPlacement placement, const int num_threads ) const {
+
+        vector< int > cpus_of_threads( num_threads, -1 );
+
+        if ( placement == CpuPlacement::NONE || m_cpus.empty() ) {
+            return cpus_of_threads;
+        }
+
+        vector< CpuInfo > order = m_cpus;
+
+        auto compact_key = []( const CpuInfo& c ) {
+            return make_tuple( c.m_node, c.m_package, c.m_l3, c.m_core, c.m_smt_index, c.m_cpu );
+        };
+
+        sort( order.begin(), order.end(), [&]( const CpuInfo& a, const CpuInfo& b ) {
+            return compact_key( a ) < compact_key( b );
+        } );
+
+        if ( placement == CpuPlacement::ONE_PER_CORE ) {
+
+            order.erase( remove_if( order.begin(), order.end(), []( const CpuInfo& c ) { return c.m_smt_index != 0; } ),
+                         order.end() );
+        }
+        else if ( placement == CpuPlacement::SCATTER ) {
+
+            // rank of each CPU among the CPUs with the same SMT index in its node.
+            vector< int > rank( order.size(), 0 );
+            for ( size_t i = 0; i < order.size(); i++ ) {
+                for ( size_t j = 0; j < i; j++ ) {
+                    if ( order[j].m_node == order[i].m_node && order[j].m_smt_index == order[i].m_smt_index ) {
+                        rank[i]++;
+                    }
+                }
+            }
+            vector< pair< tuple< int, int, int >, CpuInfo > > keyed;
+            for ( size_t i = 0; i < order.size(); i++ ) {
+                keyed.emplace_back( make_tuple( order[i].m_smt_index, rank[i], order[i].m_node ), order[i] );
+            }
+            stable_sort( keyed.begin(), keyed.end(), []( const auto& a, const auto& b ) { return a.first < b.first; } );
+
+            for ( size_t i = 0; i < keyed.size(); i++ ) {
+                order[i] = keyed[i].second;
+            }
+        }
+
+        for ( int i = 0; i < num_threads; i++ ) {
+            cpus_of_threads[i] = order[ i % order.size() ].m_cpu;
+        }
+        return cpus_of_threads;
+    }
+
+    /**
+     * @brief the NUMA node for each thread under the placement policy.
+     *        For NONE, it falls back to numaGroupsForThreads().
+     */
+    vector< int > numaGroups( const CpuPlacement placement, const int num_threads ) const {
+
+        if ( placement == CpuPlacement::NONE ) {
+            return numaGroupsForThreads( num_threads );
+        }
+        const auto cpus_of_threads = this->placement( placement, num_threads );
+
+        vector< int > groups( num_threads, 0 );
+
+        for ( int i = 0; i < num_threads; i++ ) {
+            for ( const auto& c : m_cpus ) {
+                if ( c.m_cpu == cpus_of_threads[i] ) {
+                    groups[i] = c.m_node;
+                }
+            }
+        }
+        return groups;
+    }
+};
+
+
+/**
+ * @brief pins the thread to the CPU with pthread_setaffinity_np().
+ *
+ * @param t   (in): the thread.
+ * @param cpu (in): the CPU number. -1 does nothing.
+ *
+ * @return true if the thread has been pinned. Always false except on Linux.
+ */
+static inline bool pinThreadToCpu( thread& t, const int cpu ) {
+
+#ifdef __linux__
+    if ( cpu < 0 || cpu >= CPU_SETSIZE ) {
+        return false;
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( cpu, &cpu_set );
+
+    return pthread_setaffinity_np( t.native_handle(), sizeof( cpu_set_t ), &cpu_set ) == 0;
+#else
+    (void)t;
+    (void)cpu;
+    return false;
+#endif
+}
+
+
+/**
+ * @brief pins the calling thread to the CPU. See pinThreadToCpu().
+ */
+static inline bool pinCurrentThreadToCpu( const int cpu ) {
+
+#ifdef __linux__
+    if ( cpu < 0 || cpu >= CPU_SETSIZE ) {
+        return false;
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( cpu, &cpu_set );
+
+    return pthread_setaffinity_np( pthread_self(), sizeof( cpu_set_t ), &cpu_set ) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+
+#endif /*__CPU_TOPOLOGY_H__*/
@@ -0,0 +1,179 @@
+#ifndef __FIRST_TOUCH_ARRAY_H__
+#define __FIRST_TOUCH_ARRAY_H__
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "parallel_executor.h"
+
+using namespace std;
+
+/**
+ * Which thread touches the pages of FirstTouchArray first.
+ * On Linux, the page is placed on the NUMA node of the CPU that touches it first.
+ *
+ * WORKERS: each worker of the ParallelExecutor initializes its own static block,
+ *          i.e., the block it gets from parallel_for() with Schedule::STATIC.
+ * MASTER:  the calling thread initializes the whole array. All the pages are
+ *          on the master's node. This is what std::vector does.
+ */
+enum class FirstTouch { WORKERS, MASTER };
+
+
+/**
+ * Backing pages of FirstTouchArray.
+ *
+ * NORMAL:      the base pages.
+ * TRANSPARENT: madvise( MADV_HUGEPAGE ) for the transparent huge pages.
+ * EXPLICIT:    mmap( MAP_HUGETLB ) from the preallocated huge page pool.
+ *              It falls back to TRANSPARENT if the pool is empty.
+ *
+ * The huge pages are available only on Linux. Elsewhere they are the same as NORMAL.
+ */
+enum class HugePages { NORMAL, TRANSPARENT, EXPLICIT };
+
+
+/**
+ * Fixed size array for the numeric data processed by a ParallelExecutor,
+ * placed on the NUMA nodes of the workers that process it.
+ *
+ * The memory is mapped but not touched at allocation, and then each worker constructs
+ * the elements of its own static block, so that each page lives on the node of the
+ * worker that owns it. It pays off when the array is processed with the static schedule
+ * on the same executor with the same range [0, size()). The workers should be pinned
+ * with a CpuPlacement so that they do not migrate to the other nodes later.
+ */
+template< class T >
+class FirstTouchArray {
+
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    T*      m_data;
+    size_t  m_size;
+    void*   m_mapping;     // the start of the mapping, m_data may be after it.
+    size_t  m_mapped_size;
+    bool    m_mapped;
+
+    void allocate( const HugePages huge_pages ) {
+
+        const size_t bytes = max( sizeof( T ) * m_size, (size_t)1 );
+
+#ifdef __linux__
+        m_mapped_size = ( bytes + HUGE_PAGE_SIZE - 1 ) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+        void* p = MAP_FAILED;
+
+        if ( huge_pages == HugePages::EXPLICIT ) {
+            // the kernel aligns MAP_HUGETLB to the huge page size.
+            p = mmap( nullptr, m_mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+        }
+        if ( p != MAP_FAILED ) {
+            m_mapping = p;
+        }
+        else {
+            // over-allocates by a huge page to align the start, as mmap() aligns only to the base page.
+            const size_t data_size = m_mapped_size;
+            if ( huge_pages != HugePages::NORMAL ) {
+                m_mapped_size += HUGE_PAGE_SIZE;
+            }
+            m_mapping = mmap( nullptr, m_mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+            if ( m_mapping == MAP_FAILED ) {
+                throw bad_alloc();
+            }
+            p = m_mapping;
+            if ( huge_pages != HugePages::NORMAL ) {
+                const uintptr_t start = reinterpret_cast< uintptr_t >( m_mapping );
+                p = reinterpret_cast< void* >( ( start + HUGE_PAGE_SIZE - 1 ) & ~( HUGE_PAGE_SIZE - 1 ) );
+#ifdef MADV_HUGEPAGE
+                madvise( p, data_size, MADV_HUGEPAGE );
+#endif
+            }
+        }
+        m_data   = static_cast< T* >( p );
+        m_mapped = true;
+#else
+        (void)huge_pages;
+        m_mapped_size = bytes;
+        m_data        = static_cast< T* >( ::operator new( bytes, align_val_t( alignof( T ) ) ) );
+        m_mapped      = false;
+#endif
+    }
+
+    void deallocate() {
+
+#ifdef __linux__
+        if ( m_mapped ) {
+            munmap( m_mapping, m_mapped_size );
+            return;
+        }
+#endif
+        ::operator delete( m_data, align_val_t( alignof( T ) ) );
+    }
+
+  public:
+
+    /**
+     * @param executor    (in): the executor whose workers process the array.
+     * @param size        (in): number of the elements.
+     * @param value       (in): initial value of the elements.
+     * @param first_touch (in): which thread initializes the elements.
+     * @param huge_pages  (in): the backing pages.
+     */
+    FirstTouchArray( ParallelExecutor& executor,
+                     const size_t      size,
+                     const T&          value       = T(),
+                     const FirstTouch  first_touch = FirstTouch::WORKERS,
+                     const HugePages   huge_pages  = HugePages::NORMAL )
+        :m_data        ( nullptr )
+        ,m_size        ( size )
+        ,m_mapping     ( nullptr )
+        ,m_mapped_size ( 0 )
+        ,m_mapped      ( false )
+    {
+        allocate( huge_pages );
+
+        if ( first_touch == FirstTouch::WORKERS ) {
+            executor.parallel_for( (size_t)0, m_size, [&]( const size_t i ) {
+                new ( &m_data[i] ) T( value );
+            } );
+        }
+        else {
+            for ( size_t i = 0; i < m_size; i++ ) {
+                new ( &m_data[i] ) T( value );
+            }
+        }
+    }
+
+    FirstTouchArray( const FirstTouchArray& ) = delete;
+    FirstTouchArray& operator=( const FirstTouchArray& ) = delete;
+
+    ~FirstTouchArray() {
+
+        if ( !is_trivially_destructible< T >::value ) {
+            for ( size_t i = 0; i < m_size; i++ ) {
+                m_data[i].~T();
+            }
+        }
+        deallocate();
+    }
+
+    size_t size() const { return m_size; }
+
+    T*       data()       { return m_data; }
+    const T* data() const { return m_data; }
+
+    T*       begin()       { return m_data; }
+    T*       end()         { return m_data + m_size; }
+    const T* begin() const { return m_data; }
+    const T* end()   const { return m_data + m_size; }
+
+    T&       operator[]( const size_t i )       { return m_data[i]; }
+    const T& operator[]( const size_t i ) const { return m_data[i]; }
+};
+
+#endif /*__FIRST_TOUCH_ARRAY_H__*/
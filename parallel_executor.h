@@ -0,0 +1,621 @@
+#ifndef __PARALLEL_EXECUTOR_H__
+#define __PARALLEL_EXECUTOR_H__
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <array>
+#include <new>
+#include <iterator>
+#include <optional>
+
+#include "cpu_topology.h"
+#include "thread_synchronizer.h"
+#include "scratch_arena.h"
+
+using namespace std;
+
+/**
+ * Pool of worker threads with the fan-out & fan-in in thread_synchronizer.h.
+ * It owns the worker threads and the synchronizers, and dispatches a loop to the
+ * pooled workers with a single call of parallel_for().
+ * This is the pattern of the parallel scheduler in the samples packed into a class.
+ * The worker threads are created once at construction, and each dispatch costs
+ * only one round trip of WakeTreeWaitNotifyMultipleWaiters & CombiningWaitNotifyMultipleNotifiers.
+ *
+ * run() and parallel_for() must be called from one master thread, and not from the workers.
+ */
+class ParallelExecutor {
+
+  public:
+
+    /**
+     * How the indices of parallel_for() are assigned to the workers.
+     *
+     * STATIC:   one contiguous block per worker. No overhead, but the slowest block decides.
+     * DYNAMIC:  chunks of a fixed size taken from a shared atomic cursor.
+     * GUIDED:   chunks taken from a shared atomic cursor, starting large and shrinking
+     *           with the remaining iterations, but not below the chunk size.
+     * STEALING: each worker starts with its static block and takes chunks from its front.
+     *           A worker that has run out steals the back half of another worker's block.
+     */
+    enum class Schedule { STATIC, DYNAMIC, GUIDED, STEALING };
+
+  private:
+
+    const int                            m_num_workers;
+
+    // The workers 0 ... m_num_active - 1 take part in the dispatches. Changed only by the master between the dispatches.
+    int                                  m_num_active;
+
+    WakeTreeWaitNotifyMultipleWaiters    m_fan_out;
+    CombiningWaitNotifyMultipleNotifiers m_fan_in;
+
+    // Barrier among the workers inside a dispatch. Used by the parallel scans.
+    SenseReversingWaitNotifyEachOther    m_sync;
+
+    // The task for the current dispatch. They are set by the master before the fan-out.
+    void*                                m_task_context;
+    void                               (*m_task_invoke)( void*, const int );
+
+    vector< thread >                     m_threads;
+
+    // Shared cursor for DYNAMIC and GUIDED as an offset from begin.
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic< int64_t > m_cursor;
+
+    // Remaining range of each worker for STEALING as offsets from begin packed in ( first << 32 | last ).
+    vector< CacheLineAligned< atomic< uint64_t > > > m_ranges;
+
+    // Per-worker partial results of parallel_reduce(), each on its own cache line(s).
+    using CacheLine = CacheLineAligned< array< unsigned char, THREAD_SYNCHRONIZER_CACHE_LINE_SIZE > >;
+    vector< CacheLine > m_partials;
+
+    // Per-worker scratch memory. Each arena is reset when its worker reaches the fan-in.
+    vector< CacheLineAligned< ScratchArena > > m_scratch;
+
+    /**
+     * @brief makes room for one T per worker in m_partials.
+     */
+    template< class T >
+    void reservePartials() {
+
+        static_assert( alignof( T ) <= THREAD_SYNCHRONIZER_CACHE_LINE_SIZE, "over-aligned type" );
+
+        const size_t lines_per_partial = ( sizeof( T ) + sizeof( CacheLine ) - 1 ) / sizeof( CacheLine );
+
+        if ( m_partials.size() < lines_per_partial * m_num_workers ) {
+            m_partials.resize( lines_per_partial * m_num_workers );
+        }
+    }
+
+    /**
+     * @brief the uninitialized storage for the partial of the given worker.
+     */
+    template< class T >
+    T* partialSlot( const int thread_id ) {
+
+        const size_t lines_per_partial = ( sizeof( T ) + sizeof( CacheLine ) - 1 ) / sizeof( CacheLine );
+
+        return reinterpret_cast< T* >( m_partials[ thread_id * lines_per_partial ].m_value.data() );
+    }
+
+    /**
+     * @brief two-pass block scan in place. init is nullptr for the inclusive scan.
+     */
+    template< class ITER, class OP >
+    void parallelScan( const ITER first, const ITER last, const typename iterator_traits< ITER >::value_type* init, OP& op ) {
+
+        using T       = typename iterator_traits< ITER >::value_type;
+        using PARTIAL = optional< T >;
+
+        reservePartials< PARTIAL >();
+
+        const auto len = last - first;
+
+        auto task = [&]( const int thread_id ) {
+
+            const auto range = staticBlock( decltype( len )( 0 ), len, thread_id, m_num_active );
+
+            // pass 1: reduce the block.
+            PARTIAL block_sum;
+            for ( auto i = range.first; i < range.second; i++ ) {
+                block_sum = block_sum ? op( *block_sum, first[i] ) : first[i];
+            }
+            new ( partialSlot< PARTIAL >( thread_id ) ) PARTIAL( move( block_sum ) );
+
+            m_sync.syncThreads( thread_id );
+
+            // scan of the block sums up to this block.
+            PARTIAL offset;
+            if ( init != nullptr ) {
+                offset = *init;
+            }
+            for ( int j = 0; j < thread_id; j++ ) {
+                const PARTIAL& s = *partialSlot< PARTIAL >( j );
+                if ( s ) {
+                    offset = offset ? op( *offset, *s ) : *s;
+                }
+            }
+
+            // pass 2: scan the block with the offset.
+            if ( init != nullptr ) {
+                T acc = *offset;
+                for ( auto i = range.first; i < range.second; i++ ) {
+                    T next = op( acc, first[i] );
+                    first[i] = move( acc );
+                    acc = move( next );
+                }
+            }
+            else {
+                for ( auto i = range.first; i < range.second; i++ ) {
+                    if ( offset ) {
+                        first[i] = op( *offset, first[i] );
+                    }
+                    offset = first[i];
+                }
+            }
+        };
+        run( task );
+
+        for ( int i = 0; i < m_num_active; i++ ) {
+            partialSlot< PARTIAL >( i )->~PARTIAL();
+        }
+    }
+
+    static inline uint64_t packRange( const uint64_t first, const uint64_t last ) {
+        return ( first << 32 ) | last;
+    }
+
+    /**
+     * @brief takes a chunk from the front of the worker's own range.
+     */
+    inline bool popOwnChunk( const int thread_id, const int64_t chunk_size, int64_t& first, int64_t& last ) {
+
+        auto&    range  = m_ranges[ thread_id ].m_value;
+        uint64_t packed = range.load( memory_order_acquire );
+
+        while ( true ) {
+            const int64_t f = (int64_t)( packed >> 32 );
+            const int64_t l = (int64_t)( packed & 0xffffffff );
+            if ( f >= l ) {
+                return false;
+            }
+            const int64_t new_f = min( f + chunk_size, l );
+            if ( range.compare_exchange_weak( packed, packRange( new_f, l ), memory_order_acq_rel, memory_order_acquire ) ) {
+                first = f;
+                last  = new_f;
+                return true;
+            }
+        }
+    }
+
+    /**
+     * @brief steals the back half of another worker's range and makes it the worker's own range.
+     */
+    inline bool stealRange( const int thread_id ) {
+
+        for ( int k = 1; k < m_num_active; k++ ) {
+
+            auto&    victim = m_ranges[ ( thread_id + k ) % m_num_active ].m_value;
+            uint64_t packed = victim.load( memory_order_acquire );
+
+            while ( true ) {
+                const int64_t f = (int64_t)( packed >> 32 );
+                const int64_t l = (int64_t)( packed & 0xffffffff );
+                if ( l - f < 2 ) {
+                    break;
+                }
+                const int64_t mid = f + ( l - f ) / 2;
+                if ( victim.compare_exchange_weak( packed, packRange( f, mid ), memory_order_acq_rel, memory_order_acquire ) ) {
+                    m_ranges[ thread_id ].m_value.store( packRange( mid, l ), memory_order_release );
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    template< class INDEX, class BODY >
+    void runSchedule( const INDEX begin, const INDEX end, BODY& body, Schedule schedule, int64_t chunk_size ) {
+
+        const int64_t len = ( end > begin ) ? (int64_t)( end - begin ) : 0;
+
+        if ( chunk_size <= 0 ) {
+            chunk_size = max( (int64_t)1, len / ( (int64_t)m_num_active * 16 ) );
+        }
+        if ( schedule == Schedule::STEALING && len > 0xffffffffLL ) {
+            schedule = Schedule::DYNAMIC;
+        }
+
+        m_cursor.store( 0, memory_order_release );
+
+        if ( schedule == Schedule::STEALING ) {
+            for ( int i = 0; i < m_num_active; i++ ) {
+                const auto r = staticBlock( (int64_t)0, len, i, m_num_active );
+                m_ranges[ i ].m_value.store( packRange( r.first, r.second ), memory_order_release );
+            }
+        }
+
+        auto run_chunk = [&]( const int64_t first, const int64_t last ) {
+            for ( int64_t i = first; i < last; i++ ) {
+                body( (INDEX)( begin + i ) );
+            }
+        };
+
+        auto task = [&]( const int thread_id ) {
+
+            switch ( schedule ) {
+
+              case Schedule::DYNAMIC:
+                while ( true ) {
+                    const int64_t first = m_cursor.fetch_add( chunk_size, memory_order_acq_rel );
+                    if ( first >= len ) {
+                        break;
+                    }
+                    run_chunk( first, min( first + chunk_size, len ) );
+                }
+                break;
+
+              case Schedule::GUIDED:
+                while ( true ) {
+                    int64_t first = m_cursor.load( memory_order_acquire );
+                    int64_t last  = 0;
+                    do {
+                        if ( first >= len ) {
+                            break;
+                        }
+                        const int64_t size = max( chunk_size, ( len - first ) / ( 2 * m_num_active ) );
+                        last = min( first + size, len );
+                    } while ( !m_cursor.compare_exchange_weak( first, last, memory_order_acq_rel, memory_order_acquire ) );
+
+                    if ( first >= len ) {
+                        break;
+                    }
+                    run_chunk( first, last );
+                }
+                break;
+
+              case Schedule::STEALING:
+                while ( true ) {
+                    int64_t first = 0;
+                    int64_t last  = 0;
+                    if ( popOwnChunk( thread_id, chunk_size, first, last ) ) {
+                        run_chunk( first, last );
+                    }
+                    else if ( !stealRange( thread_id ) ) {
+                        break;
+                    }
+                }
+                break;
+
+              case Schedule::STATIC:
+              default:
+                {
+                    const auto r = staticBlock( (int64_t)0, len, thread_id, m_num_active );
+                    run_chunk( r.first, r.second );
+                }
+                break;
+            }
+        };
+        run( task );
+    }
+
+    void workerLoop( const int thread_id ) {
+
+        THREAD_SYNCHRONIZER_TRACE_THREAD_NAME( "ParallelExecutor worker " + to_string( thread_id ) );
+
+        while ( true ) {
+
+            m_fan_out.wait( thread_id );
+            if ( m_fan_out.isTerminating() ) {
+                break;
+            }
+
+            {
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "ParallelExecutor::task" );
+                m_task_invoke( m_task_context, thread_id );
+            }
+
+            m_scratch[ thread_id ].m_value.reset();
+
+            m_fan_in.notify( thread_id );
+            if ( m_fan_in.isTerminating() ) {
+                break;
+            }
+        }
+    }
+
+  public:
+
+    /**
+     * @param num_workers (in): number of the worker threads in the pool.
+     * @param wait_policy (in): spin-then-park policy for the fan-out & fan-in.
+     * @param placement   (in): how the workers are pinned to the CPUs. See CpuPlacement in cpu_topology.h.
+     */
+    ParallelExecutor( const int          num_workers,
+                      const WaitPolicy&  wait_policy = WaitPolicy(),
+                      const CpuPlacement placement   = CpuPlacement::NONE )
+        :m_num_workers  ( num_workers )
+        ,m_num_active   ( num_workers )
+        ,m_fan_out      ( num_workers, 2, wait_policy )
+        ,m_fan_in       ( num_workers, 0, wait_policy )
+        ,m_sync         ( num_workers, wait_policy )
+        ,m_task_context ( nullptr )
+        ,m_task_invoke  ( nullptr )
+        ,m_cursor       ( 0 )
+        ,m_ranges       ( num_workers )
+        ,m_scratch      ( num_workers )
+    {
+        for ( int i = 0; i < m_num_workers; i++ ) {
+            m_threads.emplace_back( &ParallelExecutor::workerLoop, this, i );
+        }
+        if ( placement != CpuPlacement::NONE ) {
+
+            const auto cpus = CpuTopology().placement( placement, m_num_workers );
+
+            for ( int i = 0; i < m_num_workers; i++ ) {
+                pinThreadToCpu( m_threads[i], cpus[i] );
+            }
+        }
+    }
+
+    ~ParallelExecutor() {
+
+        m_fan_out.terminate();
+        m_fan_in.terminate();
+        m_sync.terminate();
+
+        for ( auto& t : m_threads ) {
+            t.join();
+        }
+    }
+
+    int numWorkers() const { return m_num_workers; }
+
+    /**
+     * @brief changes the number of the workers that take part in the dispatches without
+     *        recreating the threads. The workers numActiveWorkers() ... numWorkers() - 1 stay
+     *        parked in the fan-out until they are activated again. All the dispatches
+     *        including the schedules, the reductions and the scans split the work over the active workers.
+     *        Call it from the master between the dispatches.
+     *
+     * @param num_active (in): 1 <= num_active <= numWorkers(). Clamped to this range.
+     */
+    void setNumActiveWorkers( const int num_active ) {
+
+        m_num_active = min( max( num_active, 1 ), m_num_workers );
+        m_fan_out.setNumActive( m_num_active );
+        m_fan_in. setNumActive( m_num_active );
+        m_sync.   setNumActive( m_num_active );
+    }
+
+    int numActiveWorkers() const { return m_num_active; }
+
+    /**
+     * @brief attaches the straggler & stall detector to the fan-in, i.e., the end of each dispatch.
+     *        Call it from the master between the dispatches. nullptr to detach.
+     *
+     * @param monitor (in): for numWorkers() participants. setNumActiveWorkers() updates its active count.
+     */
+    void setArrivalMonitor( ArrivalMonitor* monitor ) {
+
+        m_fan_in.setArrivalMonitor( monitor );
+        if ( monitor != nullptr ) {
+            monitor->setNumActive( m_num_active );
+        }
+    }
+
+    /**
+     * @brief the scratch arena of the worker. Call it from the task running on that worker.
+     *        The memory allocated from it is valid until the task returns.
+     *
+     * @param thread_id (in): the thread_id passed to the task.
+     */
+    ScratchArena& scratch( const int thread_id ) { return m_scratch[ thread_id ].m_value; }
+
+    /**
+     * @brief replaces the scratch arenas with the ones of the given size,
+     *        e.g. scratchHighWaterMark() of a previous run. Call it from the master between the dispatches.
+     *        Each arena is allocated on its worker, including the inactive ones, so that the chunk
+     *        comes from the allocator of that thread and is placed near it.
+     */
+    void reserveScratch( const size_t bytes ) {
+
+        const int num_active = m_num_active;
+
+        setNumActiveWorkers( m_num_workers );
+        run( [this, bytes]( const int thread_id ) {
+            m_scratch[ thread_id ].m_value = ScratchArena( bytes );
+        } );
+        setNumActiveWorkers( num_active );
+    }
+
+    /**
+     * @brief max scratch memory in bytes used by a worker in a dispatch since the construction.
+     */
+    size_t scratchHighWaterMark() const {
+
+        size_t m = 0;
+        for ( const auto& a : m_scratch ) {
+            m = max( m, a.m_value.highWaterMark() );
+        }
+        return m;
+    }
+
+    /**
+     * @brief total number of the chunks the scratch arenas have taken from the global allocator.
+     */
+    size_t scratchChunkAllocations() const {
+
+        size_t n = 0;
+        for ( const auto& a : m_scratch ) {
+            n += a.m_value.numChunkAllocations();
+        }
+        return n;
+    }
+
+    /**
+     * @brief runs task( thread_id ) on all the active workers in parallel, and waits for them to finish.
+     *
+     * @param task (in): callable as void( const int thread_id ). 0 <= thread_id < numActiveWorkers().
+     */
+    template< class TASK >
+    void run( TASK&& task ) {
+
+        using TASK_TYPE = typename remove_reference< TASK >::type;
+
+        m_task_context = const_cast< void* >( static_cast< const void* >( &task ) );
+        m_task_invoke  = []( void* context, const int thread_id ) {
+                             ( *static_cast< TASK_TYPE* >( context ) )( thread_id );
+                         };
+        m_fan_out.notify();
+        m_fan_in.wait();
+    }
+
+    /**
+     * @brief static block partitioning of [begin, end) for the given worker.
+     *        The first (end - begin) % num_workers workers get one more index than the others.
+     *
+     * @return the sub-range [first, second) for the worker.
+     */
+    template< class INDEX >
+    static pair< INDEX, INDEX > staticBlock( const INDEX begin,
+                                             const INDEX end,
+                                             const int   thread_id,
+                                             const int   num_workers ) {
+        if ( end <= begin ) {
+            return make_pair( begin, begin );
+        }
+        const INDEX len   = end - begin;
+        const INDEX base  = len / num_workers;
+        const INDEX rem   = len % num_workers;
+        const INDEX t     = thread_id;
+        const INDEX first = begin + t * base + min( t, rem );
+        const INDEX last  = first + base + ( ( t < rem ) ? 1 : 0 );
+
+        return make_pair( first, last );
+    }
+
+    /**
+     * @brief calls body( i ) for each i in [begin, end) on the pooled workers
+     *        with the static block partitioning, and waits for them to finish.
+     *
+     * @param begin (in): the first index.
+     * @param end   (in): one past the last index.
+     * @param body  (in): callable as void( INDEX i ).
+     */
+    template< class INDEX, class BODY >
+    void parallel_for( const INDEX begin, const INDEX end, BODY&& body ) {
+
+        auto task = [&]( const int thread_id ) {
+
+            const auto range = staticBlock( begin, end, thread_id, m_num_active );
+
+            for ( INDEX i = range.first; i < range.second; i++ ) {
+                body( i );
+            }
+        };
+        run( task );
+    }
+
+    /**
+     * @brief reduces map( i ) for i in [begin, end) with combine() on the pooled workers.
+     *        Each worker reduces its static block into its own padded partial.
+     *        The master combines the partials right after the fan-in in a fixed pairwise
+     *        tree order, so no extra syncThreads() round is needed, and the result is
+     *        bitwise reproducible run to run for the same number of workers.
+     *
+     * @param begin    (in): the first index.
+     * @param end      (in): one past the last index.
+     * @param identity (in): the identity element of combine(), e.g. 0.0 for +.
+     * @param map      (in): callable as T( INDEX i ).
+     * @param combine  (in): callable as T( const T&, const T& ). It must be associative.
+     *
+     * @return the reduced value.
+     */
+    template< class T, class INDEX, class MAP, class COMBINE >
+    T parallel_reduce( const INDEX begin, const INDEX end, const T& identity, MAP&& map, COMBINE&& combine ) {
+
+        reservePartials< T >();
+
+        auto partial = [&]( const int thread_id ) { return partialSlot< T >( thread_id ); };
+
+        auto task = [&]( const int thread_id ) {
+
+            const auto range = staticBlock( begin, end, thread_id, m_num_active );
+
+            T acc = identity;
+            for ( INDEX i = range.first; i < range.second; i++ ) {
+                acc = combine( acc, map( i ) );
+            }
+            new ( partial( thread_id ) ) T( move( acc ) );
+        };
+        run( task );
+
+        for ( int stride = 1; stride < m_num_active; stride *= 2 ) {
+            for ( int i = 0; i + stride < m_num_active; i += 2 * stride ) {
+                *partial( i ) = combine( *partial( i ), *partial( i + stride ) );
+            }
+        }
+
+        T result = move( *partial( 0 ) );
+
+        for ( int i = 0; i < m_num_active; i++ ) {
+            partial( i )->~T();
+        }
+        return result;
+    }
+
+    /**
+     * @brief inclusive prefix scan of [first, last) in place: x[i] = x[0] op x[1] op ... op x[i].
+     *        It is the two-pass block scan. Each worker reduces its static block,
+     *        the workers meet once at the internal barrier, and then each worker scans
+     *        its block starting from the combined sums of the blocks before it.
+     *
+     * @param first (in/out): random access iterator to the first element.
+     * @param last  (in):     one past the last element.
+     * @param op    (in):     associative binary operation callable as T( const T&, const T& ).
+     */
+    template< class ITER, class OP >
+    void parallel_inclusive_scan( const ITER first, const ITER last, OP&& op ) {
+        parallelScan( first, last, nullptr, op );
+    }
+
+    /**
+     * @brief exclusive prefix scan of [first, last) in place: x[i] = init op x[0] op ... op x[i-1].
+     *        See parallel_inclusive_scan().
+     *
+     * @param first (in/out): random access iterator to the first element.
+     * @param last  (in):     one past the last element.
+     * @param init  (in):     the value for x[0], usually the identity of op.
+     * @param op    (in):     associative binary operation callable as T( const T&, const T& ).
+     */
+    template< class ITER, class OP >
+    void parallel_exclusive_scan( const ITER first, const ITER last,
+                                  const typename iterator_traits< ITER >::value_type& init, OP&& op ) {
+        parallelScan( first, last, &init, op );
+    }
+
+    /**
+     * @brief calls body( i ) for each i in [begin, end) on the pooled workers
+     *        with the given schedule, and waits for them to finish.
+     *        Use it for the loops whose iterations cost differently, such as
+     *        the rows of a sparse matrix.
+     *
+     * @param begin      (in): the first index.
+     * @param end        (in): one past the last index.
+     * @param body       (in): callable as void( INDEX i ).
+     * @param schedule   (in): how the indices are assigned to the workers.
+     * @param chunk_size (in): number of indices taken at once for DYNAMIC & STEALING,
+     *                         and the minimum for GUIDED. <= 0 for (end - begin) / (16 * numWorkers()).
+     */
+    template< class INDEX, class BODY >
+    void parallel_for( const INDEX begin, const INDEX end, BODY&& body, const Schedule schedule, const int64_t chunk_size = 0 ) {
+
+        runSchedule( begin, end, body, schedule, chunk_size );
+    }
+};
+
+
+#endif /*__PARALLEL_EXECUTOR_H__*/
@@ -0,0 +1,36 @@
+#include <iostream>
+#include <vector>
+#include "parallel_executor.h"
+
+using namespace std;
+
+int main( int argc, char* argv[] ) {
+
+    // 4 worker threads are created once and pooled.
+    ParallelExecutor executor(4);
+
+    const int      N = 1000;
+    vector<double> x( N, 1.0 );
+    vector<double> y( N, 2.0 );
+    vector<double> z( N, 0.0 );
+
+    for ( int iter = 0; iter < 10 ; iter++ ) {
+
+        // [0, N) is split into 4 blocks, one per worker.
+        executor.parallel_for( 0, N, [&]( const int i ) {
+            z[i] += x[i] * y[i];
+        } );
+    }
+
+    cout << "z[0]: " << z[0] << " z[N-1]: " << z[N-1] << "\n";
+
+    // each worker runs the task with its thread_id.
+    mutex mt;
+    executor.run( [&]( const int thread_id ) {
+        mt.lock();
+        cout << "worker: " << thread_id << " of " << executor.numWorkers() << "\n" << flush;
+        mt.unlock();
+    } );
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include "thread_synchronizer.h"
+
+using namespace std;
+
+// 4 stages in a pipeline with up to 3 items in flight.
+// Stage i can work on item n+1 while stage i+1 works on item n.
+// Each item has its own slot, and the credits bound the number of the items in flight.
+int main( int argc, char* argv[] ) {
+
+    const int NUM_STAGES    = 4;
+    const int MAX_IN_FLIGHT = 3;
+    const int NUM_ITEMS     = 10;
+
+    WaitNotifyCounting credits( MAX_IN_FLIGHT, MAX_IN_FLIGHT );
+    WaitNotifyCounting wn1( MAX_IN_FLIGHT ), wn2( MAX_IN_FLIGHT ), wn3( MAX_IN_FLIGHT ), wn4( MAX_IN_FLIGHT );
+
+    WaitNotifyCounting* links[ NUM_STAGES ] = { &wn1, &wn2, &wn3, &wn4 };
+
+    vector<int> slots( MAX_IN_FLIGHT );
+    mutex       mt;
+
+    auto stage = [&]( const int stage_no ) {
+
+        int item = 0;
+
+        while (true) {
+
+            links[ stage_no ]->wait();
+            if ( links[ stage_no ]->isTerminating() )
+                break;
+
+            auto& value = slots[ item % MAX_IN_FLIGHT ];
+            value += stage_no + 1;
+
+            mt.lock();
+            cout << "stage " << stage_no + 1 << "\titem: " << item << "\tvalue: " << value << "\n" << flush;
+            mt.unlock();
+
+            item++;
+
+            if ( stage_no == NUM_STAGES - 1 ) {
+                value = 0;
+                credits.notify(); // the slot is free again.
+            }
+            else {
+                links[ stage_no + 1 ]->notify();
+            }
+        }
+    };
+
+    thread th1( stage, 0 );
+    thread th2( stage, 1 );
+    thread th3( stage, 2 );
+    thread th4( stage, 3 );
+
+    for ( int i = 0; i < NUM_ITEMS; i++ ) {
+
+        credits.wait();
+        wn1.notify();
+    }
+
+    // waiting for the last items to leave the pipeline.
+    for ( int i = 0; i < MAX_IN_FLIGHT; i++ ) {
+        credits.wait();
+    }
+
+    wn1.terminate();
+    wn2.terminate();
+    wn3.terminate();
+    wn4.terminate();
+
+    th1.join();
+    th2.join();
+    th3.join();
+    th4.join();
+
+    return 0;
+}
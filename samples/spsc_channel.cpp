@@ -0,0 +1,58 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <numeric>
+#include "spsc_channel.h"
+
+using namespace std;
+
+// Two pipeline stages pass the buffers through the channels.
+// Stage 1 fills a buffer, stage 2 sums it up, and the buffer goes back to stage 1
+// through the return channel, so the buffers are moved around without copies.
+int main( int argc, char* argv[] ) {
+
+    const int NUM_BUFFERS = 2;
+    const int NUM_ITEMS   = 10;
+
+    SPSCChannel< vector< double > > to_stage2( NUM_BUFFERS );
+    SPSCChannel< vector< double > > to_stage1( NUM_BUFFERS );
+
+    for ( int i = 0; i < NUM_BUFFERS; i++ ) {
+        to_stage1.emplace( 1024, 0.0 );
+    }
+
+    auto stage1 = [&] {
+
+        vector< double > buffer;
+
+        for ( int i = 0; i < NUM_ITEMS; i++ ) {
+
+            to_stage1.pop( buffer );
+            iota( buffer.begin(), buffer.end(), (double)i );
+            cout << "stage 1\titem: " << i << "\n" << flush;
+            to_stage2.push( move( buffer ) );
+        }
+        to_stage2.terminate();
+    };
+
+    auto stage2 = [&] {
+
+        vector< double > buffer;
+        int              item = 0;
+
+        while ( to_stage2.pop( buffer ) ) {
+
+            const double sum = accumulate( buffer.begin(), buffer.end(), 0.0 );
+            cout << "stage 2\titem: " << item++ << "\tsum: " << sum << "\n" << flush;
+            to_stage1.push( move( buffer ) );
+        }
+    };
+
+    thread th1( stage1 );
+    thread th2( stage2 );
+
+    th1.join();
+    th2.join();
+
+    return 0;
+}
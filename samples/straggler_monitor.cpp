@@ -0,0 +1,60 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "thread_synchronizer.h"
+
+using namespace std;
+
+// 4 workers run phases separated by syncThreads(). Worker 2 is descheduled
+// in every 50th phase, simulated with a sleep. The monitor reports it as the last arriver,
+// and the phases over the 2 ms threshold with the arrival order.
+// The watchdog reports the phase while it is still open with the missing thread_id.
+int main( int argc, char* argv[] ) {
+
+    const int NUM_WORKERS = 4;
+    const int NUM_PHASES  = 500;
+    const int LATE_WORKER = 2;
+
+    WaitNotifyEachOther wn( NUM_WORKERS );
+    ArrivalMonitor      monitor( NUM_WORKERS, chrono::milliseconds( 2 ) );
+
+    wn.setArrivalMonitor( &monitor );
+
+    monitor.setStallHandler( []( const PhaseReport& report ) {
+        cout << "stall: " << report.summary() << "\n";
+    } );
+    monitor.startWatchdog( chrono::milliseconds( 1 ) );
+
+    atomic_int cnt(0);
+
+    vector< thread > workers;
+
+    for ( int i = 0; i < NUM_WORKERS; i++ ) {
+
+        workers.emplace_back( [&, i] {
+
+            for ( int phase = 1; phase <= NUM_PHASES; phase++ ) {
+
+                cnt++;
+
+                if ( i == LATE_WORKER && phase % 50 == 0 ) {
+                    this_thread::sleep_for( chrono::milliseconds( 10 ) );
+                }
+                wn.syncThreads( i );
+            }
+        } );
+    }
+
+    for ( auto& t : workers ) {
+        t.join();
+    }
+    monitor.stopWatchdog();
+
+    cout << "cnt: " << cnt.load() << "\n";
+    cout << monitor.summary();
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+// The counters are compiled in only with this macro.
+#define THREAD_SYNCHRONIZER_ENABLE_COUNTERS
+#include "thread_synchronizer.h"
+
+using namespace std;
+
+static void print( const string& name, const SyncCounters& c ) {
+
+    cout << name
+         << "\tspins: "            << c.m_num_spins
+         << "\tblocking waits: "   << c.m_num_blocking_waits
+         << "\tspurious wakeups: " << c.m_num_spurious_wakeups
+         << "\tlock wait[ns]: "    << c.m_lock_wait_ns
+         << "\twakeups: "          << c.m_num_wakeups
+         << "\tmean notify-to-wake[ns]: "
+         << ( c.m_num_wakeups > 0 ? c.m_notify_to_wake_ns / c.m_num_wakeups : 0 )
+         << "\tmax[ns]: "          << c.m_max_notify_to_wake_ns << "\n";
+}
+
+// The parallel scheduler of parallel_scheduler.cpp with 3 workers.
+// The master polls the counters of the fan-out after every 1000 iterations as a monitor would.
+int main( int argc, char* argv[] ) {
+
+    const int NUM_WORKERS    = 3;
+    const int NUM_ITERATIONS = 3000;
+
+    WaitNotifyMultipleWaiters   wn_fan_out( NUM_WORKERS );
+    WaitNotifyMultipleNotifiers wn_fan_in ( NUM_WORKERS );
+
+    atomic_int cnt(0);
+
+    vector< thread > workers;
+
+    for ( int i = 0; i < NUM_WORKERS; i++ ) {
+
+        workers.emplace_back( [&, i] {
+            while (true) {
+
+                wn_fan_out.wait(i);
+                if (wn_fan_out.isTerminating())
+                    break;
+
+                cnt++;
+
+                wn_fan_in.notify(i);
+            }
+        } );
+    }
+
+    for ( int i = 1; i <= NUM_ITERATIONS ; i++ ) {
+
+        wn_fan_out.notify();
+        wn_fan_in.wait();
+
+        if ( i % 1000 == 0 ) {
+
+            auto& counters = wn_fan_out.counters();
+
+            cout << "after " << i << " iterations\n";
+            for ( int slot = 0; slot < NUM_WORKERS; slot++ ) {
+                print( "  worker " + to_string( slot ), counters.snapshot( slot ) );
+            }
+            print( "  notifier", counters.snapshot( NUM_WORKERS ) );
+            print( "  fan-in  ", wn_fan_in.counters().snapshot() );
+
+            counters.reset();
+            wn_fan_in.counters().reset();
+        }
+    }
+    wn_fan_out.terminate();
+
+    for ( auto& t : workers ) {
+        t.join();
+    }
+    cout << "cnt: " << cnt.load() << "\n";
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "task_graph.h"
+
+using namespace std;
+
+// The same flow as parallel_scheduler_with_mid_sync.cpp declared as a graph.
+// The mid-sync is the series of the two parallel nodes. The inner loop is compiled into
+// a region of 3 threads with 1 fan-out & fan-in pair and 1 barrier.
+int main( int argc, char* argv[] ) {
+
+    mutex      mt;
+    atomic_int cnt(0);
+
+    auto part = [&]( const int tid, const int part_no ) {
+
+        return TaskGraph::task( [&, tid, part_no] {
+            lock_guard< mutex > lock( mt );
+            cout << "task: " << tid << " part " << part_no << " outer loop: " << cnt << "\n" << flush;
+        } );
+    };
+
+    int inner_cnt = 0;
+
+    auto inner_loop = TaskGraph::loop(
+                          TaskGraph::series( {
+                              TaskGraph::parallel( { part( 0, 1 ), part( 1, 1 ), part( 2, 1 ) } ),
+                              TaskGraph::parallel( { part( 0, 2 ), part( 1, 2 ), part( 2, 2 ) } ),
+                              TaskGraph::task( [&]{ inner_cnt++; } )
+                          } ),
+                          [&]{ return inner_cnt < 4; }
+                      );
+
+    auto outer_loop = TaskGraph::loop(
+                          TaskGraph::series( {
+                              TaskGraph::task( [&]{ inner_cnt = 0; } ),
+                              inner_loop,
+                              TaskGraph::task( [&]{ cnt++; } )
+                          } ),
+                          [&]{ return cnt < 10; }
+                      );
+
+    TaskGraph graph( outer_loop );
+
+    cout << "threads: " << graph.numThreads() << " fan-out & fan-in pairs: " << graph.numForks()
+         << " barriers: " << graph.numBarriers() << "\n";
+
+    // The same synchronizers as the hand-wired version.
+    if ( graph.numThreads() != 3 || graph.numForks() != 1 || graph.numBarriers() != 1 ) {
+        cerr << "unexpected compilation.\n";
+        return 1;
+    }
+
+    graph.run();
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+// The trace hooks are compiled in only with this macro.
+#define THREAD_SYNCHRONIZER_ENABLE_TRACE
+#include "parallel_executor.h"
+
+using namespace std;
+
+// A loop with the load imbalance: the cost of element i grows with i, so the last
+// worker of the static schedule finishes last. Open trace_timeline.json in
+// ui.perfetto.dev to see the other workers waiting in wait() for the next dispatch,
+// and the master waiting in the fan-in.
+int main( int argc, char* argv[] ) {
+
+    const string path = ( argc > 1 ) ? argv[1] : "trace_timeline.json";
+
+    TraceRecorder::setThreadName( "master" );
+
+    // collects the rings in the background so that they do not overflow in a long run.
+    TraceRecorder::instance().startFlusher();
+
+    {
+        ParallelExecutor executor(4);
+
+        const int      N = 4000;
+        vector<double> x( N, 1.0 );
+
+        for ( int iter = 0; iter < 10 ; iter++ ) {
+
+            executor.parallel_for( 0, N, [&]( const int i ) {
+                for ( int j = 0; j < i; j++ ) {
+                    x[i] = sqrt( x[i] + j );
+                }
+            } );
+        }
+        cout << "x[N-1]: " << x[N-1] << "\n";
+    }
+
+    TraceRecorder::instance().stopFlusher();
+
+    if ( !TraceRecorder::instance().writeChromeTrace( path ) ) {
+        cerr << "cannot write " << path << "\n";
+        return 1;
+    }
+    cout << "trace written to " << path
+         << " (dropped events: " << TraceRecorder::instance().numDropped() << ")\n";
+
+    return 0;
+}
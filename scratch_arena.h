@@ -0,0 +1,181 @@
+#ifndef __SCRATCH_ARENA_H__
+#define __SCRATCH_ARENA_H__
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Bump allocator for the per-iteration scratch memory of a worker thread.
+ *
+ * allocate() only advances an offset in the current chunk. If the chunk runs out,
+ * a new chunk is taken from the global allocator. reset() releases everything at once,
+ * and if more than one chunk has been used, it replaces them with a single chunk of the
+ * high-water mark, so that from the next iteration on no allocation hits the global allocator.
+ *
+ * Not thread-safe. Each worker owns its own arena.
+ */
+class ScratchArena {
+
+    static constexpr size_t MIN_CHUNK_SIZE = 4096;
+
+    vector< unique_ptr< unsigned char[] > > m_chunks;
+    vector< size_t >                        m_chunk_sizes;
+
+    size_t  m_offset;          // in the last chunk
+    size_t  m_used;            // bytes handed out since the last reset(), including the alignment padding
+    size_t  m_high_water_mark;
+    size_t  m_num_chunk_allocations;
+
+    void addChunk( const size_t min_bytes ) {
+
+        const size_t last = m_chunk_sizes.empty() ? 0 : m_chunk_sizes.back();
+        const size_t size = max( { min_bytes, MIN_CHUNK_SIZE, last * 2 } );
+
+        // the unused tail of the previous chunk is not counted in m_used.
+        m_chunks.emplace_back( new unsigned char[ size ] );
+        m_chunk_sizes.push_back( size );
+        m_offset = 0;
+        m_num_chunk_allocations++;
+    }
+
+  public:
+
+    /**
+     * @param initial_bytes (in): size of the first chunk. 0 allocates on the first allocate().
+     */
+    ScratchArena( const size_t initial_bytes = 0 )
+        :m_offset                ( 0 )
+        ,m_used                  ( 0 )
+        ,m_high_water_mark       ( 0 )
+        ,m_num_chunk_allocations ( 0 )
+    {
+        if ( initial_bytes > 0 ) {
+            addChunk( initial_bytes );
+        }
+    }
+
+    ScratchArena( ScratchArena&& ) = default;
+    ScratchArena& operator=( ScratchArena&& ) = default;
+
+    /**
+     * @brief allocates uninitialized memory valid until the next reset().
+     *
+     * @param bytes     (in): size in bytes.
+     * @param alignment (in): power of 2.
+     */
+    inline void* allocate( const size_t bytes, const size_t alignment = alignof( max_align_t ) ) {
+
+        if ( !m_chunks.empty() ) {
+
+            const uintptr_t base    = reinterpret_cast< uintptr_t >( m_chunks.back().get() );
+            const uintptr_t aligned = ( base + m_offset + alignment - 1 ) & ~( alignment - 1 );
+            const size_t    end     = aligned - base + bytes;
+
+            if ( end <= m_chunk_sizes.back() ) {
+                m_used            += end - m_offset;
+                m_offset           = end;
+                m_high_water_mark  = max( m_high_water_mark, m_used );
+                return reinterpret_cast< void* >( aligned );
+            }
+        }
+        addChunk( bytes + alignment );
+        return allocate( bytes, alignment );
+    }
+
+    /**
+     * @brief allocates an array of n default-initialized T valid until the next reset().
+     *        T must be trivially destructible, as the destructors are never called.
+     */
+    template< class T >
+    inline T* allocate( const size_t n ) {
+
+        static_assert( is_trivially_destructible< T >::value, "ScratchArena does not call the destructors" );
+
+        T* p = static_cast< T* >( allocate( sizeof( T ) * n, alignof( T ) ) );
+        for ( size_t i = 0; i < n; i++ ) {
+            new ( p + i ) T;
+        }
+        return p;
+    }
+
+    /**
+     * @brief releases all the memory allocated since the last reset().
+     */
+    void reset() {
+
+        if ( m_chunks.size() > 1 ) {
+
+            m_chunks.clear();
+            m_chunk_sizes.clear();
+            addChunk( m_high_water_mark + alignof( max_align_t ) );
+        }
+        m_offset = 0;
+        m_used   = 0;
+    }
+
+    /**
+     * @brief max number of the bytes in use at once since the construction.
+     *        Pass it to the constructor to avoid the chunk allocations during the warm-up.
+     */
+    size_t highWaterMark() const { return m_high_water_mark; }
+
+    /**
+     * @brief number of the chunks taken from the global allocator since the construction.
+     */
+    size_t numChunkAllocations() const { return m_num_chunk_allocations; }
+
+    /**
+     * @brief total size of the chunks currently held.
+     */
+    size_t capacity() const {
+
+        size_t total = 0;
+        for ( const auto s : m_chunk_sizes ) {
+            total += s;
+        }
+        return total;
+    }
+};
+
+
+/**
+ * Standard allocator on ScratchArena for the containers used as scratch,
+ * e.g. vector< double, ScratchAllocator< double > > v( n, 0.0, ScratchAllocator< double >( arena ) ).
+ * deallocate() does nothing. The memory is released by ScratchArena::reset().
+ */
+template< class T >
+class ScratchAllocator {
+
+    template< class U > friend class ScratchAllocator;
+
+    ScratchArena* m_arena;
+
+  public:
+
+    using value_type = T;
+
+    ScratchAllocator( ScratchArena& arena ) : m_arena( &arena ) {;}
+
+    template< class U >
+    ScratchAllocator( const ScratchAllocator< U >& other ) : m_arena( other.m_arena ) {;}
+
+    T* allocate( const size_t n ) {
+        return static_cast< T* >( m_arena->allocate( sizeof( T ) * n, alignof( T ) ) );
+    }
+
+    void deallocate( T*, const size_t ) {;}
+
+    template< class U >
+    bool operator==( const ScratchAllocator< U >& other ) const { return m_arena == other.m_arena; }
+
+    template< class U >
+    bool operator!=( const ScratchAllocator< U >& other ) const { return m_arena != other.m_arena; }
+};
+
+#endif /*__SCRATCH_ARENA_H__*/
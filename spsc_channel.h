@@ -0,0 +1,261 @@
+#ifndef __SPSC_CHANNEL_H__
+#define __SPSC_CHANNEL_H__
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "thread_synchronizer.h"
+
+using namespace std;
+
+/**
+ * Bounded lock-free ring buffer for a single producer & a single consumer.
+ * It carries the payload between two pipeline stages, while the synchronizers
+ * in thread_synchronizer.h carry only the go signals.
+ *
+ * The producer owns the tail and the consumer owns the head. Each side keeps its own
+ * index and a cached copy of the other side's index on its own cache line, and reads
+ * the other side's line only when the cached copy says the ring is full or empty.
+ * The elements are constructed in place in the ring and moved out by pop().
+ *
+ * pop() spins and parks with WaitPolicy as WaitNotifySingleFutex::wait() does.
+ * emplace() waits in a spin lock while the ring is full as WaitNotifySingleFutex::notify() does.
+ */
+template< class T >
+class SPSCChannel {
+
+    static constexpr uint32_t SLEEPING    = 0x1;
+    static constexpr uint32_t TERMINATING = 0x2;
+
+    struct Slot {
+        alignas( T ) unsigned char m_bytes[ sizeof( T ) ];
+    };
+
+    const size_t         m_mask;
+    unique_ptr< Slot[] > m_slots;
+    const WaitPolicy     m_wait_policy;
+
+    // consumer side
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic< size_t > m_head;
+    size_t                                                          m_cached_tail;
+
+    // producer side
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic< size_t > m_tail;
+    size_t                                                          m_cached_head;
+
+    // the consumer sleeping in pop() & termination
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) AtomicWaitWord   m_state;
+
+    static size_t roundUpToPowerOf2( const size_t n ) {
+
+        size_t p = 1;
+        while ( p < n ) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    inline T* slot( const size_t index ) {
+        return reinterpret_cast< T* >( m_slots[ index & m_mask ].m_bytes );
+    }
+
+    /**
+     * @brief wakes up the consumer if it is parked in pop().
+     */
+    inline void wakeConsumer() {
+
+        // Pairs with the fetch_or() in waitForData(). Either the consumer sees the new
+        // tail, or the producer sees SLEEPING.
+        atomic_thread_fence( memory_order_seq_cst );
+
+        auto& word = m_state.word();
+
+        if ( ( word.load( memory_order_relaxed ) & SLEEPING ) != 0 ) {
+            word.fetch_and( ~SLEEPING, memory_order_acq_rel );
+            m_state.wakeOne();
+        }
+    }
+
+    /**
+     * @brief waits until the element at head is available or the channel is terminated.
+     *
+     * @return true if the element is available.
+     */
+    inline bool waitForData( const size_t head ) {
+
+        auto& word = m_state.word();
+
+        const bool available = m_wait_policy.spinUntil( [&] {
+            m_cached_tail = m_tail.load( memory_order_acquire );
+            return m_cached_tail != head || ( word.load( memory_order_acquire ) & TERMINATING ) != 0;
+        } );
+
+        if ( !available ) {
+
+            while ( true ) {
+
+                const uint32_t state = word.fetch_or( SLEEPING, memory_order_seq_cst ) | SLEEPING;
+
+                m_cached_tail = m_tail.load( memory_order_seq_cst );
+
+                if ( m_cached_tail != head || ( state & TERMINATING ) != 0 ) {
+                    word.fetch_and( ~SLEEPING, memory_order_acq_rel );
+                    break;
+                }
+                m_state.waitWhileEqual( state );
+            }
+        }
+        return m_cached_tail != head;
+    }
+
+  public:
+
+    /**
+     * @param capacity    (in): max number of the elements in the ring. Rounded up to a power of 2.
+     * @param wait_policy (in): spin-then-park policy for pop() and emplace().
+     */
+    SPSCChannel( const size_t capacity, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_mask        ( roundUpToPowerOf2( capacity ) - 1 )
+        ,m_slots       ( new Slot[ m_mask + 1 ] )
+        ,m_wait_policy ( wait_policy )
+        ,m_head        ( 0 )
+        ,m_cached_tail ( 0 )
+        ,m_tail        ( 0 )
+        ,m_cached_head ( 0 )
+        ,m_state       ( 0 )
+        {;}
+
+    ~SPSCChannel() {
+
+        terminate();
+
+        const size_t tail = m_tail.load( memory_order_acquire );
+
+        for ( size_t i = m_head.load( memory_order_acquire ); i != tail; i++ ) {
+            slot( i )->~T();
+        }
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    /**
+     * @brief lets both sides know that they should stop.
+     *        pop() still returns the elements left in the ring, and then returns false.
+     */
+    void terminate() {
+
+        m_state.word().fetch_or( TERMINATING, memory_order_acq_rel );
+        m_state.wakeAll();
+    }
+
+    bool isTerminating() {
+        return ( m_state.word().load( memory_order_acquire ) & TERMINATING ) != 0;
+    }
+
+    /**
+     * @brief constructs an element at the tail if the ring is not full. Producer only.
+     *
+     * @return true if the element has been constructed.
+     */
+    template< class... ARGS >
+    inline bool tryEmplace( ARGS&&... args ) {
+
+        const size_t tail = m_tail.load( memory_order_relaxed );
+
+        if ( tail - m_cached_head > m_mask ) {
+            m_cached_head = m_head.load( memory_order_acquire );
+            if ( tail - m_cached_head > m_mask ) {
+                return false;
+            }
+        }
+        new ( slot( tail ) ) T( forward< ARGS >( args )... );
+
+        m_tail.store( tail + 1, memory_order_release );
+
+        wakeConsumer();
+        return true;
+    }
+
+    /**
+     * @brief constructs an element at the tail. Producer only.
+     *        It waits in a spin lock while the ring is full.
+     *
+     * @return true if the element has been constructed. false if the channel has been terminated.
+     */
+    template< class... ARGS >
+    inline bool emplace( ARGS&&... args ) {
+
+        const size_t tail = m_tail.load( memory_order_relaxed );
+
+        if ( tail - m_cached_head > m_mask ) {
+            m_wait_policy.busyWaitUntil( [&] {
+                m_cached_head = m_head.load( memory_order_acquire );
+                return tail - m_cached_head <= m_mask || isTerminating();
+            } );
+        }
+        if ( isTerminating() ) {
+            return false;
+        }
+        new ( slot( tail ) ) T( forward< ARGS >( args )... );
+
+        m_tail.store( tail + 1, memory_order_release );
+
+        wakeConsumer();
+        return true;
+    }
+
+    inline bool push( T&& value )      { return emplace( move( value ) ); }
+    inline bool push( const T& value ) { return emplace( value ); }
+
+    /**
+     * @brief moves out the element at the head if the ring is not empty. Consumer only.
+     *
+     * @return true if an element has been moved to value.
+     */
+    inline bool tryPop( T& value ) {
+
+        const size_t head = m_head.load( memory_order_relaxed );
+
+        if ( head == m_cached_tail ) {
+            m_cached_tail = m_tail.load( memory_order_acquire );
+            if ( head == m_cached_tail ) {
+                return false;
+            }
+        }
+        T* p = slot( head );
+        value = move( *p );
+        p->~T();
+
+        m_head.store( head + 1, memory_order_release );
+        return true;
+    }
+
+    /**
+     * @brief moves out the element at the head. Consumer only.
+     *        It waits until an element is available.
+     *
+     * @return true if an element has been moved to value.
+     *         false if the channel has been terminated and the ring is empty.
+     */
+    inline bool pop( T& value ) {
+
+        const size_t head = m_head.load( memory_order_relaxed );
+
+        if ( head == m_cached_tail ) {
+            m_cached_tail = m_tail.load( memory_order_acquire );
+            if ( head == m_cached_tail && !waitForData( head ) ) {
+                return false;
+            }
+        }
+        T* p = slot( head );
+        value = move( *p );
+        p->~T();
+
+        m_head.store( head + 1, memory_order_release );
+        return true;
+    }
+};
+
+#endif /*__SPSC_CHANNEL_H__*/
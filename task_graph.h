@@ -0,0 +1,670 @@
+#ifndef __TASK_GRAPH_H__
+#define __TASK_GRAPH_H__
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cpu_topology.h"
+#include "thread_synchronizer.h"
+
+using namespace std;
+
+/**
+ * Declarative execution flow in an SP-digraph with feedback edges.
+ *
+ * The graph is described with task(), series(), parallel() and loop(), and then
+ * compiled once by the constructor of TaskGraph into the synchronizers and the threads.
+ * run() executes the whole graph once on the calling thread and the helper threads.
+ *
+ * - series:   the nodes run one after another on the same thread. No hand-off.
+ * - parallel: branch 0 runs on the thread that reached the node, and branch i >= 1
+ *             on helper thread i - 1 of the region the node belongs to.
+ * - loop:     the feedback edge. The body runs repeatedly while the condition returns true.
+ *             The condition is evaluated before each iteration.
+ *
+ * Nested series in series and parallel in parallel are flattened, and the series and
+ * parallel of a single node are replaced with the node itself.
+ *
+ * The parallel nodes are compiled into regions. A region is forked once with one
+ * WakeTreeWaitNotifyMultipleWaiters and joined once with one CombiningWaitNotifyMultipleNotifiers,
+ * and its threads run the region as a single program:
+ *
+ * - A parallel node on its own is a region.
+ * - A series with two or more children that contain parallel nodes of the same width W,
+ *   and a loop whose body is a region, form one region of W threads. Branch i of all the
+ *   parallel nodes in it runs on the same thread, and the adjacent parallel nodes are
+ *   joined with one WaitNotifyEachOther instead of a fan-in and a fan-out.
+ *   The nodes without any parallel node in it, and the loop conditions, run on thread 0
+ *   between the barriers, and the other threads wait in the barrier meanwhile.
+ *
+ * Hence the compiled graph uses no more threads and synchronizers than the hand-wired version.
+ * A node is a value, and each copy of it in the graph is compiled into its own steps
+ * and regions. Use loop() to repeat a sub-graph.
+ *
+ * Ex. parallel_scheduler_with_mid_sync.cpp with 3 workers:
+ *
+ *   auto g = TaskGraph::loop(
+ *                TaskGraph::series( {
+ *                    TaskGraph::parallel( { part1(0), part1(1), part1(2) } ),
+ *                    TaskGraph::parallel( { part2(0), part2(1), part2(2) } ),
+ *                    TaskGraph::task( [&]{ cnt++; } )
+ *                } ),
+ *                [&]{ return cnt < 10; }
+ *            );
+ *   TaskGraph graph( g );
+ *   graph.run();
+ *
+ * It is compiled into a region of 3 threads with 1 fan-out & fan-in pair and 1 barrier.
+ *
+ * run() must not be called concurrently.
+ */
+class TaskGraph {
+
+  public:
+
+    /**
+     * Declaration of a node. It is a plain value and owns its sub-nodes.
+     */
+    class Node {
+
+        friend class TaskGraph;
+
+        enum class Kind { TASK, SERIES, PARALLEL, LOOP };
+
+        Kind                 m_kind;
+        function< void() >   m_task;
+        function< bool() >   m_condition;
+        vector< Node >       m_children;
+
+        Node( const Kind kind ) : m_kind( kind ) {;}
+    };
+
+    /**
+     * @brief a leaf node.
+     *
+     * @param f (in): the work of the node callable as void().
+     */
+    static Node task( function< void() > f ) {
+
+        Node n( Node::Kind::TASK );
+        n.m_task = move( f );
+        return n;
+    }
+
+    /**
+     * @brief the nodes run one after another.
+     */
+    static Node series( vector< Node > nodes ) {
+
+        Node n( Node::Kind::SERIES );
+        n.m_children = move( nodes );
+        return n;
+    }
+
+    /**
+     * @brief the nodes run in parallel, and the node finishes when all of them have finished.
+     */
+    static Node parallel( vector< Node > nodes ) {
+
+        Node n( Node::Kind::PARALLEL );
+        n.m_children = move( nodes );
+        return n;
+    }
+
+    /**
+     * @brief the feedback edge. The body runs repeatedly while the condition returns true.
+     *
+     * @param body      (in): the node to repeat.
+     * @param condition (in): callable as bool(). Evaluated before each iteration.
+     */
+    static Node loop( Node body, function< bool() > condition ) {
+
+        Node n( Node::Kind::LOOP );
+        n.m_condition = move( condition );
+        n.m_children.push_back( move( body ) );
+        return n;
+    }
+
+  private:
+
+    using Kind = Node::Kind;
+
+    /**
+     * Compiled step run by a single thread. The children are the indices to m_steps.
+     */
+    struct Step {
+
+        enum class Kind { TASK, SERIES, LOOP, REGION };
+
+        Kind                 m_kind;
+        function< void() >   m_task;
+        function< bool() >   m_condition;
+        vector< int >        m_children;
+        int                  m_region; // index to m_regions for REGION
+    };
+
+    /**
+     * Instruction of the program of a region run by all its threads.
+     * The children are the indices to m_ops.
+     *
+     * BRANCHES: thread t runs step m_branches[t].
+     * SERIAL:   thread 0 runs step m_step.
+     * SEQUENCE: the children one after another.
+     * LOOP:     thread 0 evaluates the condition into m_continue, and then all the threads
+     *           see it after the barrier, and run the body m_children[0].
+     * BARRIER:  syncThreads() on the barrier of the region.
+     */
+    struct Op {
+
+        enum class Kind { BRANCHES, SERIAL, SEQUENCE, LOOP, BARRIER };
+
+        Kind                 m_kind;
+        vector< int >        m_branches;
+        int                  m_step;
+        function< bool() >   m_condition;
+        bool                 m_continue;
+        vector< int >        m_children;
+    };
+
+    /**
+     * How an op starts or ends, to decide if a barrier is needed between two ops.
+     */
+    enum class Edge { ALL_THREADS, THREAD_0, SYNCED };
+
+    /**
+     * Synchronizers of a region. Thread t >= 1 is helper t - 1.
+     */
+    struct Region {
+
+        const int                               m_width;
+        WakeTreeWaitNotifyMultipleWaiters       m_fan_out;
+        CombiningWaitNotifyMultipleNotifiers    m_fan_in;
+        unique_ptr< WaitNotifyEachOther >       m_barrier;     // nullptr if the program has no BARRIER.
+        int                                     m_program;     // index to m_ops
+
+        Region( const int width, const WaitPolicy& wait_policy )
+            :m_width   ( width )
+            ,m_fan_out ( width - 1, 2, wait_policy )
+            ,m_fan_in  ( width - 1, 0, wait_policy )
+            ,m_program ( -1 )
+        {;}
+    };
+
+    const WaitPolicy               m_wait_policy;
+    vector< Step >                 m_steps;
+    vector< Op >                   m_ops;
+    vector< unique_ptr< Region > > m_regions;
+    vector< thread >               m_threads;
+    int                            m_root;
+
+    /**
+     * @brief appends the nodes to flat, replacing the nested nodes of the same kind with their children.
+     */
+    static void flatten( const Node& node, const Kind kind, vector< const Node* >& flat ) {
+
+        for ( const auto& child : node.m_children ) {
+            if ( child.m_kind == kind ) {
+                flatten( child, kind, flat );
+            }
+            else {
+                flat.push_back( &child );
+            }
+        }
+    }
+
+    /**
+     * @brief the node itself, or the single node it is replaced with.
+     */
+    static const Node& collapse( const Node& node ) {
+
+        if ( node.m_kind == Kind::SERIES || node.m_kind == Kind::PARALLEL ) {
+            vector< const Node* > flat;
+            flatten( node, node.m_kind, flat );
+            if ( flat.size() == 1 ) {
+                return collapse( *flat[0] );
+            }
+        }
+        return node;
+    }
+
+    /**
+     * @brief the width of the parallel nodes in the node outside their branches.
+     *
+     * @return 0 if there is no parallel node, -1 if the widths differ.
+     */
+    static int width( const Node& n ) {
+
+        const Node& node = collapse( n );
+
+        switch ( node.m_kind ) {
+
+          case Kind::TASK:
+            return 0;
+
+          case Kind::LOOP:
+            return width( node.m_children[0] );
+
+          case Kind::PARALLEL:
+          case Kind::SERIES:
+          default:
+          {
+            vector< const Node* > flat;
+            flatten( node, node.m_kind, flat );
+
+            if ( node.m_kind == Kind::PARALLEL && !flat.empty() ) {
+                return flat.size();
+            }
+            int w = 0;
+            for ( const auto* child : flat ) {
+                const int cw = width( *child );
+                if ( cw < 0 || ( cw > 0 && w > 0 && cw != w ) ) {
+                    return -1;
+                }
+                w = max( w, cw );
+            }
+            return w;
+          }
+        }
+    }
+
+    /**
+     * @brief true if the node is compiled into a region as a whole.
+     *        A series must contain two or more parallel parts, as otherwise the region
+     *        would not save any fork & join but add barriers around the serial parts.
+     */
+    static bool isRegion( const Node& n ) {
+
+        const Node& node = collapse( n );
+
+        if ( width( node ) <= 0 ) {
+            return false;
+        }
+        switch ( node.m_kind ) {
+
+          case Kind::PARALLEL:
+            return true;
+
+          case Kind::LOOP:
+            return isRegion( node.m_children[0] );
+
+          case Kind::SERIES:
+          {
+            vector< const Node* > flat;
+            flatten( node, node.m_kind, flat );
+
+            int num_parallel_parts = 0;
+            for ( const auto* child : flat ) {
+                if ( width( *child ) > 0 ) {
+                    num_parallel_parts++;
+                }
+            }
+            return num_parallel_parts >= 2;
+          }
+
+          case Kind::TASK:
+          default:
+            return false;
+        }
+    }
+
+    int addOp( Op op ) {
+        op.m_continue = false;
+        m_ops.push_back( move( op ) );
+        return m_ops.size() - 1;
+    }
+
+    /**
+     * @brief compiles the node of width > 0 into the ops of the region.
+     *
+     * @param begin (out): how the op starts.
+     * @param end   (out): how the op ends.
+     *
+     * @return the index of the op to m_ops.
+     */
+    int compileRegionOp( const Node& n, Region& region, Edge& begin, Edge& end ) {
+
+        const Node& node = collapse( n );
+
+        Op op;
+        op.m_step = -1;
+
+        switch ( node.m_kind ) {
+
+          case Kind::PARALLEL:
+          {
+            vector< const Node* > flat;
+            flatten( node, node.m_kind, flat );
+
+            op.m_kind = Op::Kind::BRANCHES;
+            for ( const auto* child : flat ) {
+                op.m_branches.push_back( compile( *child ) );
+            }
+            begin = Edge::ALL_THREADS;
+            end   = Edge::ALL_THREADS;
+            break;
+          }
+
+          case Kind::LOOP:
+          {
+            op.m_kind      = Op::Kind::LOOP;
+            op.m_condition = node.m_condition;
+
+            Edge body_begin, body_end;
+            const int body = compileRegionOp( node.m_children[0], region, body_begin, body_end );
+
+            // the condition must see the results of the previous iteration.
+            if ( body_end == Edge::ALL_THREADS ) {
+                Op seq;
+                seq.m_kind = Op::Kind::SEQUENCE;
+                seq.m_step = -1;
+                seq.m_children.push_back( body );
+                seq.m_children.push_back( addBarrier( region ) );
+                op.m_children.push_back( addOp( move( seq ) ) );
+            }
+            else {
+                op.m_children.push_back( body );
+            }
+            addBarrierIfNone( region );
+            begin = Edge::THREAD_0;
+            end   = Edge::SYNCED;
+            break;
+          }
+
+          case Kind::SERIES:
+          case Kind::TASK:
+          default:
+          {
+            vector< const Node* > flat;
+            flatten( node, node.m_kind, flat );
+
+            op.m_kind = Op::Kind::SEQUENCE;
+            begin     = Edge::SYNCED;
+            end       = Edge::SYNCED;
+
+            for ( const auto* child : flat ) {
+
+                Edge child_begin, child_end;
+                int  child_op;
+
+                if ( width( *child ) == 0 ) {
+                    Op serial;
+                    serial.m_kind = Op::Kind::SERIAL;
+                    serial.m_step = compile( *child );
+                    child_op      = addOp( move( serial ) );
+                    child_begin   = Edge::THREAD_0;
+                    child_end     = Edge::THREAD_0;
+                }
+                else {
+                    child_op = compileRegionOp( *child, region, child_begin, child_end );
+                }
+
+                if ( op.m_children.empty() ) {
+                    begin = child_begin;
+                }
+                else if (    end         != Edge::SYNCED
+                          && child_begin != Edge::SYNCED
+                          && !( end == Edge::THREAD_0 && child_begin == Edge::THREAD_0 ) ) {
+                    op.m_children.push_back( addBarrier( region ) );
+                }
+                op.m_children.push_back( child_op );
+                end = child_end;
+            }
+            break;
+          }
+        }
+        return addOp( move( op ) );
+    }
+
+    int addBarrier( Region& region ) {
+
+        addBarrierIfNone( region );
+
+        Op op;
+        op.m_kind = Op::Kind::BARRIER;
+        op.m_step = -1;
+        return addOp( move( op ) );
+    }
+
+    void addBarrierIfNone( Region& region ) {
+
+        if ( !region.m_barrier ) {
+            region.m_barrier = make_unique< WaitNotifyEachOther >( region.m_width, m_wait_policy );
+        }
+    }
+
+    /**
+     * @brief compiles the node into m_steps, m_ops and m_regions.
+     *
+     * @return the index of the step to m_steps.
+     */
+    int compile( const Node& n ) {
+
+        const Node& node = collapse( n );
+
+        Step step;
+        step.m_region = -1;
+
+        if ( isRegion( node ) ) {
+
+            const int region_index = m_regions.size();
+            m_regions.push_back( make_unique< Region >( width( node ), m_wait_policy ) );
+
+            Edge begin, end;
+            const int program = compileRegionOp( node, *m_regions[ region_index ], begin, end );
+            m_regions[ region_index ]->m_program = program;
+
+            step.m_kind   = Step::Kind::REGION;
+            step.m_region = region_index;
+        }
+        else {
+            switch ( node.m_kind ) {
+
+              case Kind::TASK:
+                step.m_kind = Step::Kind::TASK;
+                step.m_task = node.m_task;
+                break;
+
+              case Kind::LOOP:
+                step.m_kind      = Step::Kind::LOOP;
+                step.m_condition = node.m_condition;
+                step.m_children.push_back( compile( node.m_children[0] ) );
+                break;
+
+              case Kind::SERIES:
+              case Kind::PARALLEL:
+              default:
+              {
+                // the parallel nodes here have different widths, or it is an empty parallel.
+                vector< const Node* > flat;
+                flatten( node, node.m_kind, flat );
+
+                step.m_kind = Step::Kind::SERIES;
+                for ( const auto* child : flat ) {
+                    step.m_children.push_back( compile( *child ) );
+                }
+                break;
+              }
+            }
+        }
+        m_steps.push_back( move( step ) );
+        return m_steps.size() - 1;
+    }
+
+    /**
+     * @brief executes the step on the calling thread.
+     */
+    void execute( const int step_index ) {
+
+        Step& step = m_steps[ step_index ];
+
+        switch ( step.m_kind ) {
+
+          case Step::Kind::TASK:
+            step.m_task();
+            break;
+
+          case Step::Kind::SERIES:
+            for ( const auto child : step.m_children ) {
+                execute( child );
+            }
+            break;
+
+          case Step::Kind::LOOP:
+            while ( step.m_condition() ) {
+                execute( step.m_children[0] );
+            }
+            break;
+
+          case Step::Kind::REGION:
+          {
+            Region& region = *m_regions[ step.m_region ];
+            region.m_fan_out.notify();
+            runOp( region, region.m_program, 0 );
+            region.m_fan_in.wait();
+            break;
+          }
+        }
+    }
+
+    /**
+     * @brief runs the op of the region program as thread t of the region.
+     */
+    void runOp( Region& region, const int op_index, const int t ) {
+
+        Op& op = m_ops[ op_index ];
+
+        switch ( op.m_kind ) {
+
+          case Op::Kind::BRANCHES:
+            execute( op.m_branches[ t ] );
+            break;
+
+          case Op::Kind::SERIAL:
+            if ( t == 0 ) {
+                execute( op.m_step );
+            }
+            break;
+
+          case Op::Kind::SEQUENCE:
+            for ( const auto child : op.m_children ) {
+                runOp( region, child, t );
+            }
+            break;
+
+          case Op::Kind::BARRIER:
+            region.m_barrier->syncThreads( t );
+            break;
+
+          case Op::Kind::LOOP:
+            while ( true ) {
+                if ( t == 0 ) {
+                    op.m_continue = op.m_condition();
+                }
+                region.m_barrier->syncThreads( t );
+                if ( !op.m_continue || region.m_barrier->isTerminating() ) {
+                    break;
+                }
+                runOp( region, op.m_children[0], t );
+            }
+            break;
+        }
+    }
+
+    /**
+     * @brief the helper thread for thread helper_id + 1 of the region.
+     */
+    void helperLoop( const int region_index, const int helper_id ) {
+
+        Region& region = *m_regions[ region_index ];
+
+        while ( true ) {
+
+            region.m_fan_out.wait( helper_id );
+            if ( region.m_fan_out.isTerminating() ) {
+                break;
+            }
+
+            runOp( region, region.m_program, helper_id + 1 );
+
+            region.m_fan_in.notify( helper_id );
+            if ( region.m_fan_in.isTerminating() ) {
+                break;
+            }
+        }
+    }
+
+  public:
+
+    /**
+     * @param root        (in): the graph. It is copied into the compiled form.
+     * @param wait_policy (in): spin-then-park policy for the fan-out, fan-in and barrier of the regions.
+     * @param placement   (in): how the helper threads are pinned to the CPUs. See CpuPlacement in cpu_topology.h.
+     */
+    TaskGraph( const Node&        root,
+               const WaitPolicy&  wait_policy = WaitPolicy(),
+               const CpuPlacement placement   = CpuPlacement::NONE )
+        :m_wait_policy ( wait_policy )
+    {
+        m_root = compile( root );
+
+        for ( int r = 0; r < (int)m_regions.size(); r++ ) {
+            for ( int h = 0; h < m_regions[r]->m_width - 1; h++ ) {
+                m_threads.emplace_back( &TaskGraph::helperLoop, this, r, h );
+            }
+        }
+        if ( placement != CpuPlacement::NONE ) {
+
+            const auto cpus = CpuTopology().placement( placement, m_threads.size() );
+
+            for ( int i = 0; i < (int)m_threads.size(); i++ ) {
+                pinThreadToCpu( m_threads[i], cpus[i] );
+            }
+        }
+    }
+
+    ~TaskGraph() {
+
+        for ( auto& region : m_regions ) {
+            region->m_fan_out.terminate();
+            region->m_fan_in.terminate();
+            if ( region->m_barrier ) {
+                region->m_barrier->terminate();
+            }
+        }
+        for ( auto& t : m_threads ) {
+            t.join();
+        }
+    }
+
+    /**
+     * @brief number of the threads used by run() including the calling thread.
+     */
+    int numThreads() const { return m_threads.size() + 1; }
+
+    /**
+     * @brief number of the fan-out & fan-in pairs, i.e., the regions.
+     */
+    int numForks() const { return m_regions.size(); }
+
+    /**
+     * @brief number of the barriers among the threads of the regions.
+     */
+    int numBarriers() const {
+
+        int n = 0;
+        for ( const auto& region : m_regions ) {
+            n += region->m_barrier ? 1 : 0;
+        }
+        return n;
+    }
+
+    /**
+     * @brief executes the graph once, and returns when all the nodes have finished.
+     */
+    void run() {
+        execute( m_root );
+    }
+};
+
+#endif /*__TASK_GRAPH_H__*/
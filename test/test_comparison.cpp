@@ -0,0 +1,580 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <version>
+
+#if __has_include( <barrier> )
+#include <barrier>
+#endif
+#if __has_include( <latch> )
+#include <latch>
+#endif
+#if __has_include( <semaphore> )
+#include <semaphore>
+#endif
+
+#include <unistd.h>
+#if defined(_POSIX_BARRIERS) && _POSIX_BARRIERS > 0
+#include <pthread.h>
+#define HAS_PTHREAD_BARRIER
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "thread_synchronizer.h"
+#include "parallel_executor.h"
+#include "test_harness.h"
+
+using namespace std;
+
+/**
+ * Head-to-head comparison of ThreadSynchronizer with the standard alternatives
+ * on the same two workloads.
+ *
+ * fork-join: the master dispatches an empty task to N pooled workers and waits for them
+ *            in each iteration. This is the parallel scheduler with pooling.
+ * mid-sync:  N threads synchronize with each other in each iteration in a single dispatch.
+ *            This is syncThreads().
+ *
+ * The alternatives are compiled in only if the standard library or the system has them.
+ * OpenMP is used if the program is compiled with -fopenmp.
+ */
+
+
+/**
+ * fork-join with ParallelExecutor.
+ */
+class ForkJoinThreadSynchronizer : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+
+  public:
+
+    ForkJoinThreadSynchronizer( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("fork-join ThreadSynchronizer ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+            m_executor.run( []( const int ) {;} );
+        }
+    }
+
+    virtual ~ForkJoinThreadSynchronizer() {;}
+};
+
+
+/**
+ * Pool of the worker threads for the fork-join with the standard primitives.
+ * Each worker runs forkJoinWorker() until m_terminating is set.
+ */
+class ForkJoinPool : public TestCaseWithTimeMeasurements {
+
+  protected:
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    atomic_bool                 m_terminating;
+    vector< thread >            m_threads;
+
+    void start() {
+
+        for ( int i = 0; i < m_num_threads; i++ ) {
+            m_threads.emplace_back( [this, i] { workerLoop( i ); } );
+        }
+        placeThreads( m_threads );
+    }
+
+    void join() {
+
+        for ( auto& t : m_threads ) {
+            t.join();
+        }
+    }
+
+    /**
+     * @brief waits for the dispatch, does nothing, and reports back.
+     * @return false if the worker should exit.
+     */
+    virtual bool forkJoinWorker( const int thread_id ) = 0;
+
+    void workerLoop( const int thread_id ) {
+        while ( forkJoinWorker( thread_id ) ) {;}
+    }
+
+  public:
+
+    ForkJoinPool( const string type, const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements( "fork-join " + type + " " )
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_terminating        ( false )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual ~ForkJoinPool() {;}
+};
+
+
+#ifdef __cpp_lib_barrier
+/**
+ * fork-join with std::barrier of N + 1. The master and the workers meet twice per iteration.
+ */
+class ForkJoinStdBarrier : public ForkJoinPool {
+
+    barrier<>                   m_barrier;
+
+  protected:
+
+    virtual bool forkJoinWorker( const int thread_id ) {
+
+        m_barrier.arrive_and_wait(); // fan-out
+        if ( m_terminating.load( memory_order_acquire ) ) {
+            return false;
+        }
+        m_barrier.arrive_and_wait(); // fan-in
+        return true;
+    }
+
+  public:
+
+    ForkJoinStdBarrier( const int num_threads, const int num_iterations )
+        :ForkJoinPool ( "std::barrier", num_threads, num_iterations )
+        ,m_barrier    ( num_threads + 1 )
+    {
+        start();
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+            m_barrier.arrive_and_wait();
+            m_barrier.arrive_and_wait();
+        }
+    }
+
+    virtual ~ForkJoinStdBarrier() {
+
+        m_terminating.store( true, memory_order_release );
+        m_barrier.arrive_and_wait();
+        join();
+    }
+};
+#endif
+
+
+#ifdef __cpp_lib_semaphore
+/**
+ * fork-join with a binary_semaphore per worker for the fan-out, and a counting_semaphore for the fan-in.
+ */
+class ForkJoinSemaphore : public ForkJoinPool {
+
+    vector< unique_ptr< binary_semaphore > > m_go;
+    counting_semaphore<>                     m_done;
+
+  protected:
+
+    virtual bool forkJoinWorker( const int thread_id ) {
+
+        m_go[ thread_id ]->acquire();
+        if ( m_terminating.load( memory_order_acquire ) ) {
+            return false;
+        }
+        m_done.release();
+        return true;
+    }
+
+  public:
+
+    ForkJoinSemaphore( const int num_threads, const int num_iterations )
+        :ForkJoinPool ( "std::counting_semaphore", num_threads, num_iterations )
+        ,m_done       ( 0 )
+    {
+        for ( int i = 0; i < num_threads; i++ ) {
+            m_go.emplace_back( make_unique< binary_semaphore >( 0 ) );
+        }
+        start();
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            for ( auto& go : m_go ) {
+                go->release();
+            }
+            for ( int j = 0; j < m_num_threads; j++ ) {
+                m_done.acquire();
+            }
+        }
+    }
+
+    virtual ~ForkJoinSemaphore() {
+
+        m_terminating.store( true, memory_order_release );
+        for ( auto& go : m_go ) {
+            go->release();
+        }
+        join();
+    }
+};
+#endif
+
+
+#if defined(__cpp_lib_latch) && defined(__cpp_lib_semaphore)
+/**
+ * fork-join with a binary_semaphore per worker for the fan-out, and a std::latch per iteration for the fan-in.
+ * std::latch is single-use, and hence a new one is constructed in place for each iteration.
+ */
+class ForkJoinLatch : public ForkJoinPool {
+
+    vector< unique_ptr< binary_semaphore > > m_go;
+    optional< latch >                        m_done;
+
+  protected:
+
+    virtual bool forkJoinWorker( const int thread_id ) {
+
+        m_go[ thread_id ]->acquire();
+        if ( m_terminating.load( memory_order_acquire ) ) {
+            return false;
+        }
+        m_done->count_down();
+        return true;
+    }
+
+  public:
+
+    ForkJoinLatch( const int num_threads, const int num_iterations )
+        :ForkJoinPool ( "std::latch", num_threads, num_iterations )
+    {
+        for ( int i = 0; i < num_threads; i++ ) {
+            m_go.emplace_back( make_unique< binary_semaphore >( 0 ) );
+        }
+        start();
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            m_done.emplace( m_num_threads );
+
+            for ( auto& go : m_go ) {
+                go->release();
+            }
+            m_done->wait();
+        }
+    }
+
+    virtual ~ForkJoinLatch() {
+
+        m_terminating.store( true, memory_order_release );
+        for ( auto& go : m_go ) {
+            go->release();
+        }
+        join();
+    }
+};
+#endif
+
+
+#ifdef HAS_PTHREAD_BARRIER
+/**
+ * fork-join with pthread_barrier_t of N + 1. The master and the workers meet twice per iteration.
+ */
+class ForkJoinPthreadBarrier : public ForkJoinPool {
+
+    pthread_barrier_t           m_barrier;
+
+  protected:
+
+    virtual bool forkJoinWorker( const int thread_id ) {
+
+        pthread_barrier_wait( &m_barrier ); // fan-out
+        if ( m_terminating.load( memory_order_acquire ) ) {
+            return false;
+        }
+        pthread_barrier_wait( &m_barrier ); // fan-in
+        return true;
+    }
+
+  public:
+
+    ForkJoinPthreadBarrier( const int num_threads, const int num_iterations )
+        :ForkJoinPool ( "pthread_barrier", num_threads, num_iterations )
+    {
+        pthread_barrier_init( &m_barrier, nullptr, num_threads + 1 );
+        start();
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+            pthread_barrier_wait( &m_barrier );
+            pthread_barrier_wait( &m_barrier );
+        }
+    }
+
+    virtual ~ForkJoinPthreadBarrier() {
+
+        m_terminating.store( true, memory_order_release );
+        pthread_barrier_wait( &m_barrier );
+        join();
+        pthread_barrier_destroy( &m_barrier );
+    }
+};
+#endif
+
+
+#ifdef _OPENMP
+/**
+ * fork-join with a parallel region per iteration. The OpenMP runtime keeps the threads in its pool.
+ * The master takes part in the region, so it has num_threads + 1 threads in order to run
+ * num_threads tasks besides the master like the other fork-joins.
+ */
+class ForkJoinOpenMP : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    // Touched by each thread so that the parallel region is not optimized away.
+    vector< CacheLineAligned< int > > m_touched;
+
+  public:
+
+    ForkJoinOpenMP( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("fork-join OpenMP ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_touched            ( num_threads + 1 )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            #pragma omp parallel num_threads( m_num_threads + 1 )
+            {
+                m_touched[ omp_get_thread_num() ].m_value++;
+            }
+        }
+    }
+
+    virtual ~ForkJoinOpenMP() {;}
+};
+#endif
+
+
+/**
+ * Adapters to give the standard barriers the interface of WaitNotifyEachOther.
+ */
+#ifdef __cpp_lib_barrier
+class StdBarrierSync {
+
+    barrier<> m_barrier;
+
+  public:
+
+    StdBarrierSync( const int num_participants ) : m_barrier( num_participants ) {;}
+
+    inline void syncThreads( const int thread_id ) { m_barrier.arrive_and_wait(); }
+
+    void terminate() {;}
+};
+#endif
+
+#ifdef HAS_PTHREAD_BARRIER
+class PthreadBarrierSync {
+
+    pthread_barrier_t m_barrier;
+
+  public:
+
+    PthreadBarrierSync( const int num_participants ) { pthread_barrier_init( &m_barrier, nullptr, num_participants ); }
+
+    ~PthreadBarrierSync() { pthread_barrier_destroy( &m_barrier ); }
+
+    inline void syncThreads( const int thread_id ) { pthread_barrier_wait( &m_barrier ); }
+
+    void terminate() {;}
+};
+#endif
+
+
+/**
+ * mid-sync with any class that has syncThreads( thread_id ) on the pooled workers of ParallelExecutor.
+ */
+template< class SYNC >
+class MidSyncOnExecutor : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+    SYNC                        m_sync;
+
+  public:
+
+    MidSyncOnExecutor( const string variant, const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("mid-sync " + variant + " ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_sync               ( num_threads )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        m_executor.run( [&]( const int thread_id ) {
+
+            for ( int i = 0; i < m_num_iterations; i++ ) {
+                m_sync.syncThreads( thread_id );
+            }
+        } );
+    }
+
+    virtual ~MidSyncOnExecutor() {
+        m_sync.terminate();
+    }
+};
+
+
+#ifdef _OPENMP
+/**
+ * mid-sync with #pragma omp barrier in a single parallel region.
+ */
+class MidSyncOpenMP : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+  public:
+
+    MidSyncOpenMP( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("mid-sync OpenMP ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        #pragma omp parallel num_threads( m_num_threads )
+        {
+            for ( int i = 0; i < m_num_iterations; i++ ) {
+
+                #pragma omp barrier
+            }
+        }
+    }
+
+    virtual ~MidSyncOpenMP() {;}
+};
+#endif
+
+
+static const size_t NUM_TRIALS     = 10;
+static const size_t NUM_ITERATIONS = 10000;
+
+
+int main( int argc, char* argv[] ) {
+
+    // usage: test_comparison [none|compact|scatter|one_per_core] [--json=<file>] [--csv=<file>]
+    string json_path;
+    string csv_path;
+
+    if ( !parseCommandLine( argc, argv, json_path, csv_path ) ) {
+        return 1;
+    }
+
+    TestExecutor e( NUM_TRIALS );
+
+    for ( const int n : { 2, 4, 8, 16, 32, 64, 128 } ) {
+
+        e.addTestCase( make_shared< ForkJoinThreadSynchronizer >( n, NUM_ITERATIONS ) );
+#ifdef __cpp_lib_barrier
+        e.addTestCase( make_shared< ForkJoinStdBarrier         >( n, NUM_ITERATIONS ) );
+#endif
+#ifdef __cpp_lib_semaphore
+        e.addTestCase( make_shared< ForkJoinSemaphore          >( n, NUM_ITERATIONS ) );
+#endif
+#if defined(__cpp_lib_latch) && defined(__cpp_lib_semaphore)
+        e.addTestCase( make_shared< ForkJoinLatch              >( n, NUM_ITERATIONS ) );
+#endif
+#ifdef HAS_PTHREAD_BARRIER
+        e.addTestCase( make_shared< ForkJoinPthreadBarrier     >( n, NUM_ITERATIONS ) );
+#endif
+#ifdef _OPENMP
+        e.addTestCase( make_shared< ForkJoinOpenMP             >( n, NUM_ITERATIONS ) );
+#endif
+    }
+
+    for ( const int n : { 2, 4, 8, 16, 32, 64, 128 } ) {
+
+        e.addTestCase( make_shared< MidSyncOnExecutor< WaitNotifyEachOther               > >( "WaitNotifyEachOther",               n, NUM_ITERATIONS ) );
+        e.addTestCase( make_shared< MidSyncOnExecutor< SenseReversingWaitNotifyEachOther > >( "SenseReversingWaitNotifyEachOther", n, NUM_ITERATIONS ) );
+        e.addTestCase( make_shared< MidSyncOnExecutor< DisseminationWaitNotifyEachOther  > >( "DisseminationWaitNotifyEachOther",  n, NUM_ITERATIONS ) );
+#ifdef __cpp_lib_barrier
+        e.addTestCase( make_shared< MidSyncOnExecutor< StdBarrierSync                    > >( "std::barrier",                      n, NUM_ITERATIONS ) );
+#endif
+#ifdef HAS_PTHREAD_BARRIER
+        e.addTestCase( make_shared< MidSyncOnExecutor< PthreadBarrierSync                > >( "pthread_barrier",                   n, NUM_ITERATIONS ) );
+#endif
+#ifdef _OPENMP
+        e.addTestCase( make_shared< MidSyncOpenMP >( n, NUM_ITERATIONS ) );
+#endif
+    }
+
+    e.execute();
+
+    if ( !json_path.empty() ) {
+        e.writeJson( json_path );
+    }
+    if ( !csv_path.empty() ) {
+        e.writeCsv( csv_path );
+    }
+
+    return 0;
+}
@@ -8,268 +8,538 @@
 #include <atomic>
 
 #include "thread_synchronizer.h"
+#include "parallel_executor.h"
+#include "task_graph.h"
+#include "spsc_channel.h"
+#include "first_touch_array.h"
+#include "test_harness.h"
 
 using namespace std;
 
 
-class TestCaseWithTimeMeasurements {
+template< class WAIT_NOTIFY_SINGLE >
+class CyclicScheduler : public TestCaseWithTimeMeasurements {
 
-  protected:
-    string         m_type_string;
-    vector<double> m_measured_times;
-    double         m_mean_times;
-    double         m_stddev_times;
+    const int                     m_num_oscillations;
+    const int                     m_num_threads;
 
-  public:
+    WAIT_NOTIFY_SINGLE            m_wait_notify_master;                
+    vector< WAIT_NOTIFY_SINGLE* > m_wait_notify_workers;
+    vector< thread >              m_threads;
 
-    TestCaseWithTimeMeasurements( const string type )
-        :m_type_string        ( type  )
-        ,m_mean_times         ( 0.0   )
-        ,m_stddev_times       ( 0.0   )
-    {;}
+    atomic_int                    m_counter;
 
+  public:
 
-    virtual ~TestCaseWithTimeMeasurements(){;}
+    CyclicScheduler( const string backend, const int num_threads, const int num_oscillations )
+        :TestCaseWithTimeMeasurements("cyclic scheduler " + backend + " ")
+        ,m_num_oscillations( num_oscillations )
+        ,m_num_threads     ( num_threads )
+        ,m_counter         ( 0 )
 
-    void addTime( const double microseconds ) {
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(num_oscillations);
+        m_type_string += " * ";
+        m_type_string += std::to_string(num_oscillations);
+        m_type_string += "]";
 
-        m_measured_times.push_back( microseconds );
-    }
+        for ( int i = 0; i < num_threads; i++ ) {
+            m_wait_notify_workers.emplace_back( new WAIT_NOTIFY_SINGLE );
+        }
 
-    const string testType() { return m_type_string; }
+        auto task = [&]( const int num ) {
 
-    virtual const string testCaseSpecificOutput() { return ""; }
+            while ( true ) {
 
-    void calculateMeanStddevOfTime() {
+                m_wait_notify_workers[ num ]->wait();
 
-        m_mean_times = 0.0;
+                if ( m_wait_notify_workers[ num ]->isTerminating() ) {
+                    break;
+                }
+                // do task
+                if ( num == 0 ) {
+                    m_counter.fetch_add( 1, memory_order::acq_rel );
+                }
+                if ( num == m_num_threads - 1 ) {
 
-        const double len = m_measured_times.size();
+                    if ( m_counter.load( memory_order::acquire ) == m_num_oscillations ) {
+                        m_wait_notify_master.notify();
+                        continue;
+                    }
+                }
 
-        for ( auto v : m_measured_times ) {
-            m_mean_times += v;
-        }
+                m_wait_notify_workers[ (num + 1)% m_num_threads ]->notify();
 
-        m_mean_times /= len;
+                if ( m_wait_notify_workers[ num ]->isTerminating() ) {
+                    break;
+                }
+            }
+        };
 
-        m_stddev_times = 0.0;
+        for ( int i = 0; i < num_threads; i++ ) {
 
-        for ( auto v : m_measured_times ) {
+            m_threads.emplace_back( task, i );    
 
-            const double diff = v - m_mean_times;
-            const double sq   = diff * diff;
-            m_stddev_times += sq;
         }
-        m_stddev_times /= ( len - 1 );
-    }
+        placeThreads( m_threads );
 
-    virtual void print( const string preamble ) {
-        cout << setprecision(4);
-        cout << "RESULT";
-        cout << "\t";
-        cout << preamble;
-        cout << "\t";
-        cout << m_type_string;
-        cout << "\t";
-        cout << "mean: " << (m_mean_times * 1000.0) << " [ms]" ;
-        cout << "\t";
-        cout << "stddev: " << (m_stddev_times * 1000.0) << " [ms]" ;
-        cout << "\t";
-        cout << testCaseSpecificOutput();
-        cout << "\n";
     }
 
-    virtual void run() = 0;
-};
+    void run() {
 
-class TestExecutor {
+        for ( int i = 0; i < m_num_oscillations; i++ ) {
 
-  protected:
-    vector< shared_ptr< TestCaseWithTimeMeasurements > > m_test_cases;
+            m_counter.store( 0,  memory_order::release );
 
-    const int m_num_trials;
+            m_wait_notify_workers[0]->notify();
 
-  public:
-    TestExecutor( const int num_trials )
-        :m_num_trials( num_trials ) {;}
+            m_wait_notify_master.wait();
 
-    virtual ~TestExecutor(){;}
+        }
 
-    void addTestCase( shared_ptr< TestCaseWithTimeMeasurements>&& c ) {
-        m_test_cases.emplace_back( c );
     }
 
-    virtual void   prepareForBatchRuns   ( const int test_case ){;}
-    virtual void   cleanupAfterBatchRuns ( const int test_case ){;}
-    virtual void   prepareForRun         ( const int test_case, const int num ){;}
-    virtual void   cleanupAfterRun       ( const int test_case, const int num ){;}
+    virtual ~CyclicScheduler() {
 
-    virtual const string preamble () { return ""; }
+        for ( int i = 0; i < m_num_threads; i++ ) {
+            m_wait_notify_workers[i]->terminate();
+        }
 
-    void execute() {
+        for ( auto& t : m_threads ) {
+            t.join();
+        }
 
-        for ( int i = 0; i < m_test_cases.size(); i++ ) {
+        for ( int i = 0; i < m_num_threads; i++ ) {
+            delete m_wait_notify_workers[i];
+        }
+    }
 
-            auto test_case = m_test_cases[i];
+};
 
-            cout << "Testing [" << test_case->testType() << "] ";
 
-            prepareForBatchRuns(i);
+/**
+ * Pipeline of the stages linked with WaitNotifyCounting. Up to max_in_flight items are
+ * in the pipeline at once, each in its own slot. With max_in_flight = 1 it degenerates
+ * to the cyclic scheduler above, where only one stage runs at any moment.
+ */
+class PipelinedScheduler : public TestCaseWithTimeMeasurements {
 
-            for ( int j = 0; j < m_num_trials + 1; j++ ) {
+    static const int              WORK_PER_STAGE = 100;
 
-                cout << "." << flush;
+    const int                     m_num_items;
+    const int                     m_num_stages;
+    const int                     m_max_in_flight;
 
-                prepareForRun(i, j);
+    WaitNotifyCounting            m_credits;
+    vector< WaitNotifyCounting* > m_links;
+    vector< thread >              m_threads;
 
-                auto time_begin = chrono::high_resolution_clock::now();        
+    vector< CacheLineAligned< double > > m_slots;
 
-                test_case->run();
+  public:
 
-                auto time_end = chrono::high_resolution_clock::now();        
+    PipelinedScheduler( const int num_stages, const int max_in_flight, const int num_items )
+        :TestCaseWithTimeMeasurements("pipelined scheduler ")
+        ,m_num_items       ( num_items )
+        ,m_num_stages      ( num_stages )
+        ,m_max_in_flight   ( max_in_flight )
+        ,m_credits         ( max_in_flight, max_in_flight )
+        ,m_slots           ( max_in_flight )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(num_stages);
+        m_type_string += ", ";
+        m_type_string += std::to_string(max_in_flight);
+        m_type_string += ", ";
+        m_type_string += std::to_string(num_items);
+        m_type_string += "]";
+
+        for ( int i = 0; i < num_stages; i++ ) {
+            m_links.emplace_back( new WaitNotifyCounting( max_in_flight ) );
+        }
+
+        auto task = [&]( const int num ) {
+
+            // Each stage sees the items in order, and hence it knows the slot of the next item.
+            int slot = 0;
 
-                cleanupAfterRun(i, j);
+            while ( true ) {
+
+                m_links[ num ]->wait();
 
-                chrono::duration<double> time_diff = time_end - time_begin;
+                if ( m_links[ num ]->isTerminating() ) {
+                    break;
+                }
+                // do task
+                double& v = m_slots[ slot ].m_value;
+                for ( int j = 0; j < WORK_PER_STAGE; j++ ) {
+                    v = v * 0.5 + num;
+                }
+                slot = ( slot + 1 ) % m_max_in_flight;
 
-                if (j > 0) {
-                    // discard the first run.
-                    test_case->addTime( time_diff.count() );
+                if ( num == m_num_stages - 1 ) {
+                    m_credits.notify();
+                }
+                else {
+                    m_links[ num + 1 ]->notify();
                 }
             }
-            cout << "\n";
+        };
 
-            cleanupAfterBatchRuns(i);
-           
+        for ( int i = 0; i < num_stages; i++ ) {
+
+            m_threads.emplace_back( task, i );
         }
+        placeThreads( m_threads );
+    }
 
-        for ( int i = 0; i < m_test_cases.size(); i++ ) {
+    void run() {
 
-            auto t = m_test_cases[i];
+        for ( int i = 0; i < m_num_items; i++ ) {
 
-            t->calculateMeanStddevOfTime();
+            m_credits.wait();
+            m_links[0]->notify();
+        }
 
-            t->print( preamble() );
+        // drain the pipeline, and then give the credits back.
+        for ( int i = 0; i < m_max_in_flight; i++ ) {
+            m_credits.wait();
+        }
+        for ( int i = 0; i < m_max_in_flight; i++ ) {
+            m_credits.notify();
         }
     }
-};
 
+    virtual ~PipelinedScheduler() {
 
-class CyclicScheduler : public TestCaseWithTimeMeasurements {
+        for ( int i = 0; i < m_num_stages; i++ ) {
+            m_links[i]->terminate();
+        }
 
-    const int                   m_num_oscillations;
-    const int                   m_num_threads;
+        for ( auto& t : m_threads ) {
+            t.join();
+        }
 
-    WaitNotifySingle            m_wait_notify_master;                
-    vector< WaitNotifySingle* > m_wait_notify_workers;
-    vector< thread >            m_threads;
+        for ( int i = 0; i < m_num_stages; i++ ) {
+            delete m_links[i];
+        }
+    }
 
-    atomic_int                  m_counter;
+};
 
-  public:
 
-    CyclicScheduler( const int num_threads, const int num_oscillations )
-        :TestCaseWithTimeMeasurements("cyclic scheduler ")
-        ,m_num_oscillations( num_oscillations )
-        ,m_num_threads     ( num_threads )
-        ,m_counter         ( 0 )
+/**
+ * A producer thread streams the items to the master through SPSCChannel.
+ */
+class SPSCChannelStream : public TestCaseWithTimeMeasurements {
+
+    const int                     m_num_items;
+    const int                     m_capacity;
+
+    SPSCChannel< int64_t >        m_channel;
+    WaitNotifySingleFutex         m_start;
+    thread                        m_producer;
+    int64_t                       m_sum;
 
+  public:
+
+    SPSCChannelStream( const int capacity, const int num_items )
+        :TestCaseWithTimeMeasurements("spsc channel stream ")
+        ,m_num_items       ( num_items )
+        ,m_capacity        ( capacity )
+        ,m_channel         ( capacity )
+        ,m_sum             ( 0 )
     {
         m_type_string += "[";
-        m_type_string += std::to_string(num_threads);
+        m_type_string += std::to_string(capacity);
         m_type_string += ", ";
-        m_type_string += std::to_string(num_oscillations);
-        m_type_string += " * ";
-        m_type_string += std::to_string(num_oscillations);
+        m_type_string += std::to_string(num_items);
         m_type_string += "]";
 
-        for ( int i = 0; i < num_threads; i++ ) {
-            m_wait_notify_workers.emplace_back( new WaitNotifySingle );
-        }
-
-        auto task = [&]( const int num ) {
+        m_producer = thread( [&] {
 
             while ( true ) {
 
-                m_wait_notify_workers[ num ]->wait();
+                m_start.wait();
 
-                if ( m_wait_notify_workers[ num ]->isTerminating() ) {
+                if ( m_start.isTerminating() ) {
                     break;
                 }
-                // do task
-                if ( num == 0 ) {
-                    m_counter.fetch_add( 1, memory_order::acq_rel );
+                for ( int64_t i = 0; i < m_num_items; i++ ) {
+                    m_channel.emplace( i );
                 }
-                if ( num == m_num_threads - 1 ) {
+            }
+        } );
+    }
 
-                    if ( m_counter.load( memory_order::acquire ) == m_num_oscillations ) {
-                        m_wait_notify_master.notify();
-                        continue;
-                    }
-                }
+    virtual const string testCaseSpecificOutput() {
+        return "sum: " + to_string( m_sum );
+    }
 
-                m_wait_notify_workers[ (num + 1)% m_num_threads ]->notify();
+    void run() {
 
-                if ( m_wait_notify_workers[ num ]->isTerminating() ) {
+        m_start.notify();
+
+        m_sum = 0;
+        int64_t item = 0;
+        for ( int i = 0; i < m_num_items; i++ ) {
+            m_channel.pop( item );
+            m_sum += item;
+        }
+    }
+
+    virtual ~SPSCChannelStream() {
+
+        m_start.terminate();
+        m_channel.terminate();
+        m_producer.join();
+    }
+};
+
+
+/**
+ * Latency from notify() to the return from wait() of WaitNotifySingle
+ * measured for each notification in a ping-pong between the master and a worker.
+ */
+template< class WAIT_NOTIFY_SINGLE >
+class NotifyToWakeLatency : public TestCaseWithTimeMeasurements {
+
+    const int                     m_num_samples;
+
+    WAIT_NOTIFY_SINGLE            m_to_worker;
+    WAIT_NOTIFY_SINGLE            m_to_master;
+    atomic< int64_t >             m_notified_at;
+    LatencyHistogram              m_worker_latencies;
+    thread                        m_worker;
+
+  public:
+
+    NotifyToWakeLatency( const string backend, const int num_samples )
+        :TestCaseWithTimeMeasurements("notify-to-wake latency " + backend + " ")
+        ,m_num_samples     ( num_samples )
+        ,m_notified_at     ( 0 )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(num_samples);
+        m_type_string += "]";
+
+        m_worker = thread( [&] {
+
+            while ( true ) {
+
+                m_to_worker.wait();
+
+                if ( m_to_worker.isTerminating() ) {
                     break;
                 }
+                m_worker_latencies.record( nowNanoseconds() - m_notified_at.load( memory_order_acquire ) );
+
+                m_to_master.notify();
             }
-        };
+        } );
+    }
 
-        for ( int i = 0; i < num_threads; i++ ) {
+    virtual void collectLatencies( LatencyHistogram& histogram ) {
 
-            m_threads.emplace_back( task, i );    
+        histogram.merge( m_worker_latencies );
+        m_worker_latencies.clear();
+    }
+
+    void run() {
+
+        for ( int i = 0; i < m_num_samples; i++ ) {
 
+            m_notified_at.store( nowNanoseconds(), memory_order_release );
+            m_to_worker.notify();
+            m_to_master.wait();
         }
+    }
+
+    virtual ~NotifyToWakeLatency() {
 
+        m_to_worker.terminate();
+        m_to_master.terminate();
+        m_worker.join();
     }
+};
 
-    void run() {
 
-        for ( int i = 0; i < m_num_oscillations; i++ ) {
+/**
+ * Latency from notify() of the fan-out to the return from wait() in each worker,
+ * measured for each worker in each dispatch.
+ */
+template< class FAN_OUT, class FAN_IN >
+class FanOutWakeLatency : public TestCaseWithTimeMeasurements {
 
-            m_counter.store( 0,  memory_order::release );
+    const int                     m_num_samples;
+    const int                     m_num_threads;
 
-            m_wait_notify_workers[0]->notify();
+    FAN_OUT                       m_fan_out;
+    FAN_IN                        m_fan_in;
+    atomic< int64_t >             m_notified_at;
+    vector< LatencyHistogram >    m_worker_latencies;
+    vector< thread >              m_threads;
 
-            m_wait_notify_master.wait();
+  public:
+
+    FanOutWakeLatency( const string variant, const int num_threads, const int num_samples )
+        :TestCaseWithTimeMeasurements("fan-out wake latency " + variant + " ")
+        ,m_num_samples     ( num_samples )
+        ,m_num_threads     ( num_threads )
+        ,m_fan_out         ( num_threads )
+        ,m_fan_in          ( num_threads )
+        ,m_notified_at     ( 0 )
+        ,m_worker_latencies( num_threads )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(num_samples);
+        m_type_string += "]";
+
+        auto task = [&]( const int num ) {
+
+            while ( true ) {
+
+                m_fan_out.wait( num );
+                if ( m_fan_out.isTerminating() ) {
+                    break;
+                }
+                m_worker_latencies[ num ].record( nowNanoseconds() - m_notified_at.load( memory_order_acquire ) );
+
+                m_fan_in.notify( num );
+                if ( m_fan_in.isTerminating() ) {
+                    break;
+                }
+            }
+        };
 
+        for ( int i = 0; i < m_num_threads; i++ ) {
+            m_threads.emplace_back( task, i );
         }
+        placeThreads( m_threads );
+    }
+
+    virtual void collectLatencies( LatencyHistogram& histogram ) {
 
+        for ( auto& h : m_worker_latencies ) {
+            histogram.merge( h );
+            h.clear();
+        }
     }
 
-    virtual ~CyclicScheduler() {
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_samples; i++ ) {
 
-        for ( int i = 0; i < m_num_threads; i++ ) {
-            m_wait_notify_workers[i]->terminate();
+            m_notified_at.store( nowNanoseconds(), memory_order_release );
+            m_fan_out.notify();
+            m_fan_in.wait();
         }
+    }
+
+    virtual ~FanOutWakeLatency() {
+
+        m_fan_out.terminate();
+        m_fan_in.terminate();
 
         for ( auto& t : m_threads ) {
             t.join();
         }
+    }
+};
 
-        for ( int i = 0; i < m_num_threads; i++ ) {
-            delete m_wait_notify_workers[i];
+
+/**
+ * Latency from the arrival of the last thread at syncThreads() to the release of each thread,
+ * measured for each thread in each phase.
+ */
+template< class SYNC >
+class BarrierReleaseLatency : public TestCaseWithTimeMeasurements {
+
+    const int                     m_num_samples;
+    const int                     m_num_threads;
+
+    ParallelExecutor              m_executor;
+    SYNC                          m_sync;
+
+    // The latest arrival of the phase. Indexed by the parity of the phase, as the threads
+    // of the next phase may arrive before all the threads have read it.
+    atomic< int64_t >             m_last_arrival[ 2 ];
+    vector< LatencyHistogram >    m_worker_latencies;
+
+  public:
+
+    BarrierReleaseLatency( const string variant, const int num_threads, const int num_samples )
+        :TestCaseWithTimeMeasurements("barrier release latency " + variant + " ")
+        ,m_num_samples     ( num_samples )
+        ,m_num_threads     ( num_threads )
+        ,m_executor        ( num_threads, WaitPolicy(), g_placement )
+        ,m_sync            ( num_threads )
+        ,m_worker_latencies( num_threads )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(num_samples);
+        m_type_string += "]";
+
+        m_last_arrival[0] = 0;
+        m_last_arrival[1] = 0;
+    }
+
+    virtual void collectLatencies( LatencyHistogram& histogram ) {
+
+        for ( auto& h : m_worker_latencies ) {
+            histogram.merge( h );
+            h.clear();
         }
     }
 
+    virtual void run()
+    {
+        m_executor.run( [&]( const int thread_id ) {
+
+            for ( int i = 0; i < m_num_samples; i++ ) {
+
+                auto&   last    = m_last_arrival[ i & 1 ];
+                int64_t arrival = nowNanoseconds();
+                int64_t latest  = last.load( memory_order_relaxed );
+
+                // The arrivals only increase over the phases, and hence the max needs no reset.
+                while ( latest < arrival && !last.compare_exchange_weak( latest, arrival, memory_order_relaxed ) ) {;}
+
+                m_sync.syncThreads( thread_id );
+
+                m_worker_latencies[ thread_id ].record( nowNanoseconds() - last.load( memory_order_relaxed ) );
+            }
+        } );
+    }
+
+    virtual ~BarrierReleaseLatency() {
+        m_sync.terminate();
+    }
 };
 
 
+template< class FAN_OUT, class FAN_IN >
 class ParallelSchedulerWithPooling : public TestCaseWithTimeMeasurements {
 
     const int                   m_num_oscillations;
     const int                   m_num_threads;
 
-    WaitNotifyMultipleWaiters   m_wait_notify_fan_out;
-    WaitNotifyMultipleNotifiers m_wait_notify_fan_in;
+    FAN_OUT                     m_wait_notify_fan_out;
+    FAN_IN                      m_wait_notify_fan_in;
 
     vector< thread >            m_threads;
 
   public:
 
-    ParallelSchedulerWithPooling( const int num_threads, const int num_oscillations )
-        :TestCaseWithTimeMeasurements("parallel scheduler ")
+    ParallelSchedulerWithPooling( const string variant, const int num_threads, const int num_oscillations )
+        :TestCaseWithTimeMeasurements("parallel scheduler " + variant + " ")
         ,m_num_oscillations   ( num_oscillations )
         ,m_num_threads        ( num_threads )
         ,m_wait_notify_fan_out( num_threads )
@@ -291,7 +561,7 @@ class ParallelSchedulerWithPooling : public TestCaseWithTimeMeasurements {
                 }
                 // do task 1
 
-                m_wait_notify_fan_in.notify();
+                m_wait_notify_fan_in.notify( num );
                 if ( m_wait_notify_fan_in.isTerminating() ) {
                     break;
                 }
@@ -301,6 +571,7 @@ class ParallelSchedulerWithPooling : public TestCaseWithTimeMeasurements {
         for ( int i = 0; i < m_num_threads; i++ ) {
             m_threads.emplace_back( task, i );    
         }
+        placeThreads( m_threads );
     }
 
     virtual void run()
@@ -391,6 +662,7 @@ class ParallelSchedulerWithPoolingWithMidSyncOld : public TestCaseWithTimeMeasur
             m_threads.emplace_back( task1, i );
             m_threads.emplace_back( task2, i );
         }
+        placeThreads( m_threads );
     }
 
     virtual void run()
@@ -414,26 +686,40 @@ class ParallelSchedulerWithPoolingWithMidSyncOld : public TestCaseWithTimeMeasur
 };
 
 
+// The constructor argument of the mid-sync. The hierarchical one takes the NUMA node of
+// each thread under the placement the threads are pinned with.
+template< class SYNC >
+struct MidSyncParticipants {
+    static int get( const int num_threads ) { return num_threads; }
+};
+
+template<>
+struct MidSyncParticipants< HierarchicalWaitNotifyEachOther > {
+    static vector< int > get( const int num_threads ) { return CpuTopology().numaGroups( g_placement, num_threads ); }
+};
+
+
+template< class FAN_OUT, class FAN_IN, class SYNC >
 class ParallelSchedulerWithPoolingWithMidSync : public TestCaseWithTimeMeasurements {
 
     const int                   m_num_oscillations;
     const int                   m_num_threads;
 
-    WaitNotifyMultipleWaiters   m_wait_notify_fan_out;
-    WaitNotifyMultipleNotifiers m_wait_notify_fan_in;
-    WaitNotifyEachOther         m_wait_notify_sync;
+    FAN_OUT                     m_wait_notify_fan_out;
+    FAN_IN                      m_wait_notify_fan_in;
+    SYNC                        m_wait_notify_sync;
 
     vector< thread >            m_threads;
 
   public:
 
-    ParallelSchedulerWithPoolingWithMidSync( const int num_threads, const int num_oscillations )
-        :TestCaseWithTimeMeasurements("parallel scheduler with mid-sync")
+    ParallelSchedulerWithPoolingWithMidSync( const string variant, const int num_threads, const int num_oscillations )
+        :TestCaseWithTimeMeasurements("parallel scheduler with mid-sync " + variant + " ")
         ,m_num_oscillations   ( num_oscillations )
         ,m_num_threads        ( num_threads )
         ,m_wait_notify_fan_out( num_threads )
         ,m_wait_notify_fan_in ( num_threads )
-        ,m_wait_notify_sync   ( num_threads )
+        ,m_wait_notify_sync   ( MidSyncParticipants< SYNC >::get( num_threads ) )
     {
         m_type_string += "[";
         m_type_string += std::to_string(m_num_threads);
@@ -459,7 +745,7 @@ class ParallelSchedulerWithPoolingWithMidSync : public TestCaseWithTimeMeasureme
 
                 // do task2
 
-                m_wait_notify_fan_in.notify();
+                m_wait_notify_fan_in.notify( num );
                 if ( m_wait_notify_fan_in.isTerminating() ) {
                     break;
                 }
@@ -469,6 +755,7 @@ class ParallelSchedulerWithPoolingWithMidSync : public TestCaseWithTimeMeasureme
         for ( int i = 0; i < m_num_threads; i++ ) {
             m_threads.emplace_back( task, i );
         }
+        placeThreads( m_threads );
     }
 
     virtual void run()
@@ -491,11 +778,572 @@ class ParallelSchedulerWithPoolingWithMidSync : public TestCaseWithTimeMeasureme
     }
 };
 
-        
-class ParallelSchedulerNaive : public TestCaseWithTimeMeasurements {
 
-    const int m_num_threads;
-    const int m_num_iteration;
+
+class HierarchicalSyncLevels : public TestCaseWithTimeMeasurements {
+
+    const int                       m_num_oscillations;
+    const int                       m_num_threads;
+
+    WaitNotifyMultipleWaiters       m_wait_notify_fan_out;
+    WaitNotifyMultipleNotifiers     m_wait_notify_fan_in;
+    HierarchicalWaitNotifyEachOther m_wait_notify_sync;
+
+    vector< thread >                m_threads;
+
+    // measured by thread 0 only.
+    double                          m_node_level_time;
+    double                          m_global_level_time;
+    long                            m_num_syncs;
+
+  public:
+
+    HierarchicalSyncLevels( const int num_threads, const int num_oscillations )
+        :TestCaseWithTimeMeasurements("hierarchical syncThreads per level ")
+        ,m_num_oscillations   ( num_oscillations )
+        ,m_num_threads        ( num_threads )
+        ,m_wait_notify_fan_out( num_threads )
+        ,m_wait_notify_fan_in ( num_threads )
+        ,m_wait_notify_sync   ( CpuTopology().numaGroups( g_placement, num_threads ) )
+        ,m_node_level_time    ( 0.0 )
+        ,m_global_level_time  ( 0.0 )
+        ,m_num_syncs          ( 0 )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_oscillations);
+        m_type_string += "]";
+
+        auto task = [&]( const int num ) {
+
+            while ( true ) {
+                m_wait_notify_fan_out.wait( num );
+                if ( m_wait_notify_fan_out.isTerminating() ) {
+                    break;
+                }
+
+                auto time_begin = chrono::high_resolution_clock::now();        
+
+                // node level only
+                m_wait_notify_sync.syncGroup( num );
+                if ( m_wait_notify_sync.isTerminating() ) {
+                    break;
+                }
+
+                auto time_mid = chrono::high_resolution_clock::now();        
+
+                // node level + global level
+                m_wait_notify_sync.syncThreads( num );
+                if ( m_wait_notify_sync.isTerminating() ) {
+                    break;
+                }
+
+                auto time_end = chrono::high_resolution_clock::now();        
+
+                if ( num == 0 ) {
+                    chrono::duration<double> node_level   = time_mid - time_begin;
+                    chrono::duration<double> global_level = time_end - time_mid;
+                    m_node_level_time   += node_level.count();
+                    m_global_level_time += global_level.count();
+                    m_num_syncs++;
+                }
+
+                m_wait_notify_fan_in.notify();
+                if ( m_wait_notify_fan_in.isTerminating() ) {
+                    break;
+                }
+            }
+        };
+
+        for ( int i = 0; i < m_num_threads; i++ ) {
+            m_threads.emplace_back( task, i );
+        }
+        placeThreads( m_threads );
+    }
+
+    virtual const string testCaseSpecificOutput() {
+
+        const double node_level   = m_node_level_time   * 1000000.0 / m_num_syncs;
+        const double global_level = m_global_level_time * 1000000.0 / m_num_syncs;
+
+        return   "groups: "          + to_string( m_wait_notify_sync.numGroups() )
+               + "\tnode level: "   + to_string( node_level )   + " [us]"
+               + "\tboth levels: "  + to_string( global_level ) + " [us]"
+               + "\tcross-node: "   + to_string( global_level - node_level ) + " [us]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_oscillations; i++ ) {
+            m_wait_notify_fan_out.notify();
+            m_wait_notify_fan_in.wait();
+        }
+    }
+
+    ~HierarchicalSyncLevels()
+    {
+        m_wait_notify_fan_out.terminate();
+        m_wait_notify_sync.terminate();
+        m_wait_notify_fan_in.terminate();
+
+        for ( auto& t : m_threads ) {
+            t.join();
+        }
+    }
+};
+
+
+class CombiningTreeOf8 : public CombiningWaitNotifyMultipleNotifiers {
+
+  public:
+    CombiningTreeOf8( const int num_notifiers )
+        :CombiningWaitNotifyMultipleNotifiers( num_notifiers, 8 )
+        {;}
+};
+
+
+class ParallelForWithExecutor : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+    vector< int >               m_array;
+
+  public:
+
+    ParallelForWithExecutor( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("parallel_for with ParallelExecutor ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_array              ( num_threads * 16, 0 )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            m_executor.parallel_for( (size_t)0, m_array.size(), [&]( const size_t j ) {
+                m_array[j]++;
+            } );
+        }
+    }
+
+    virtual ~ParallelForWithExecutor() {;}
+};
+
+
+/**
+ * The problem size alternates between small and large. With elastic, the executor shrinks
+ * to a single active worker for the small problem and expands back to all the workers for
+ * the large one without recreating the threads. Otherwise all the workers take part in both.
+ */
+class ParallelForElastic : public TestCaseWithTimeMeasurements {
+
+    const bool                  m_elastic;
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+    vector< int >               m_small;
+    vector< int >               m_large;
+
+  public:
+
+    ParallelForElastic( const bool elastic, const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("parallel_for small & large with ParallelExecutor ")
+        ,m_elastic            ( elastic )
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_small              ( 16, 0 )
+        ,m_large              ( num_threads * 1024, 0 )
+    {
+        m_type_string += "[";
+        m_type_string += ( m_elastic ? "elastic" : "fixed" );
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            if ( m_elastic ) {
+                m_executor.setNumActiveWorkers( 1 );
+            }
+            m_executor.parallel_for( (size_t)0, m_small.size(), [&]( const size_t j ) {
+                m_small[j]++;
+            } );
+
+            if ( m_elastic ) {
+                m_executor.setNumActiveWorkers( m_num_threads );
+            }
+            m_executor.parallel_for( (size_t)0, m_large.size(), [&]( const size_t j ) {
+                m_large[j]++;
+            } );
+        }
+    }
+
+    virtual ~ParallelForElastic() {;}
+};
+
+
+class ParallelForSkewed : public TestCaseWithTimeMeasurements {
+
+    const int                    m_num_iterations;
+    const int                    m_num_threads;
+    const int                    m_num_indices;
+    ParallelExecutor::Schedule   m_schedule;
+
+    ParallelExecutor             m_executor;
+    vector< double >             m_array;
+
+    static string scheduleName( const ParallelExecutor::Schedule schedule ) {
+
+        switch ( schedule ) {
+          case ParallelExecutor::Schedule::STATIC:   return "static";
+          case ParallelExecutor::Schedule::DYNAMIC:  return "dynamic";
+          case ParallelExecutor::Schedule::GUIDED:   return "guided";
+          case ParallelExecutor::Schedule::STEALING: return "stealing";
+        }
+        return "";
+    }
+
+  public:
+
+    /**
+     * The cost of index i grows linearly with i, and the first 1/8 of the indices cost
+     * nothing, so the last static block costs about twice as much as the average.
+     */
+    ParallelForSkewed( const ParallelExecutor::Schedule schedule, const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("parallel_for skewed ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_num_indices        ( num_threads * 64 )
+        ,m_schedule           ( schedule )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_array              ( num_threads * 64, 0.0 )
+    {
+        m_type_string += scheduleName( schedule );
+        m_type_string += " [";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            m_executor.parallel_for( 0, m_num_indices, [&]( const int j ) {
+
+                const int cost = ( j < m_num_indices / 8 ) ? 0 : j * 4;
+                double    v    = m_array[j];
+                for ( int k = 0; k < cost; k++ ) {
+                    v = v * 0.999 + 1.0;
+                }
+                m_array[j] = v;
+
+            }, m_schedule );
+        }
+    }
+
+    virtual ~ParallelForSkewed() {;}
+};
+
+
+class ParallelReduceWithExecutor : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+    vector< double >            m_array;
+    double                      m_norm;
+
+  public:
+
+    ParallelReduceWithExecutor( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("parallel_reduce with ParallelExecutor ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_array              ( num_threads * 16, 0.5 )
+        ,m_norm               ( 0.0 )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual const string testCaseSpecificOutput() {
+        return "squared norm: " + to_string( m_norm );
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            m_norm = m_executor.parallel_reduce( (size_t)0, m_array.size(), 0.0,
+                                                 [&]( const size_t j ) { return m_array[j] * m_array[j]; },
+                                                 []( const double a, const double b ) { return a + b; } );
+        }
+    }
+
+    virtual ~ParallelReduceWithExecutor() {;}
+};
+
+
+class ParallelScanWithExecutor : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+    vector< double >            m_array;
+
+  public:
+
+    ParallelScanWithExecutor( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("parallel_inclusive_scan with ParallelExecutor ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_array              ( num_threads * 16, 0.0 )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual const string testCaseSpecificOutput() {
+        return "last element: " + to_string( m_array.back() );
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            fill( m_array.begin(), m_array.end(), 1.0 );
+
+            m_executor.parallel_inclusive_scan( m_array.begin(), m_array.end(),
+                                                []( const double a, const double b ) { return a + b; } );
+        }
+    }
+
+    virtual ~ParallelScanWithExecutor() {;}
+};
+        
+class ParallelSchedulerWithTaskGraph : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    vector< int >               m_array;
+    int                         m_iteration;
+    unique_ptr< TaskGraph >     m_graph;
+
+    TaskGraph::Node makeGraph() {
+
+        vector< TaskGraph::Node > branches;
+        for ( int t = 0; t < m_num_threads; t++ ) {
+            branches.push_back( TaskGraph::task( [this, t]{ m_array[ t * 16 ]++; } ) );
+        }
+        return TaskGraph::loop(
+                   TaskGraph::series( {
+                       TaskGraph::parallel( branches ),
+                       TaskGraph::task( [this]{ m_iteration++; } )
+                   } ),
+                   [this]{ return m_iteration < m_num_iterations; }
+               );
+    }
+
+  public:
+
+    ParallelSchedulerWithTaskGraph( const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements("parallel scheduler with TaskGraph ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_array              ( num_threads * 16, 0 )
+        ,m_iteration          ( 0 )
+        ,m_graph              ( make_unique< TaskGraph >( makeGraph(), WaitPolicy(), g_placement ) )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual void run()
+    {
+        m_iteration = 0;
+        m_graph->run();
+    }
+
+    virtual ~ParallelSchedulerWithTaskGraph() {;}
+};
+
+
+/**
+ * Each worker needs a temporary buffer in every dispatch. It is taken either from
+ * the global allocator with std::vector or from the worker's scratch arena.
+ */
+class ScratchPerDispatch : public TestCaseWithTimeMeasurements {
+
+    static const int            SCRATCH_SIZE = 1024;
+
+    const bool                  m_use_arena;
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+
+    ParallelExecutor            m_executor;
+    vector< CacheLineAligned< double > > m_results;
+
+  public:
+
+    ScratchPerDispatch( const bool use_arena, const int num_threads, const int num_iterations )
+        :TestCaseWithTimeMeasurements( use_arena ? "scratch per dispatch arena " : "scratch per dispatch std::vector " )
+        ,m_use_arena          ( use_arena )
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_results            ( num_threads )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual const string testCaseSpecificOutput() {
+        return "high-water mark: "    + to_string( m_executor.scratchHighWaterMark() )
+             + " chunk allocations: " + to_string( m_executor.scratchChunkAllocations() );
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            m_executor.run( [&]( const int thread_id ) {
+
+                if ( m_use_arena ) {
+                    double* tmp = m_executor.scratch( thread_id ).allocate< double >( SCRATCH_SIZE );
+                    for ( int j = 0; j < SCRATCH_SIZE; j++ ) {
+                        tmp[j] = j;
+                    }
+                    m_results[ thread_id ].m_value = tmp[ SCRATCH_SIZE - 1 ];
+                }
+                else {
+                    vector< double > tmp( SCRATCH_SIZE );
+                    for ( int j = 0; j < SCRATCH_SIZE; j++ ) {
+                        tmp[j] = j;
+                    }
+                    m_results[ thread_id ].m_value = tmp[ SCRATCH_SIZE - 1 ];
+                }
+            } );
+        }
+    }
+
+    virtual ~ScratchPerDispatch() {;}
+};
+
+
+/**
+ * Memory bandwidth of the STREAM triad a[i] = b[i] + s * c[i] with ParallelExecutor,
+ * with the arrays touched first either by the master or by the workers.
+ */
+class FirstTouchBandwidth : public TestCaseWithTimeMeasurements {
+
+    const int                   m_num_iterations;
+    const int                   m_num_threads;
+    const size_t                m_num_elements;
+
+    ParallelExecutor            m_executor;
+    FirstTouchArray< double >   m_a;
+    FirstTouchArray< double >   m_b;
+    FirstTouchArray< double >   m_c;
+
+    static string firstTouchName( const FirstTouch first_touch, const HugePages huge_pages ) {
+
+        string name = ( first_touch == FirstTouch::WORKERS ) ? "worker-touched" : "master-touched";
+
+        switch ( huge_pages ) {
+          case HugePages::TRANSPARENT: return name + " thp";
+          case HugePages::EXPLICIT:    return name + " hugetlb";
+          default:                     return name;
+        }
+    }
+
+  public:
+
+    FirstTouchBandwidth(
+        const FirstTouch first_touch,
+        const HugePages  huge_pages,
+        const int        num_threads,
+        const size_t     num_elements,
+        const int        num_iterations
+    )
+        :TestCaseWithTimeMeasurements("first touch bandwidth " + firstTouchName( first_touch, huge_pages ) + " ")
+        ,m_num_iterations     ( num_iterations )
+        ,m_num_threads        ( num_threads )
+        ,m_num_elements       ( num_elements )
+        ,m_executor           ( num_threads, WaitPolicy(), g_placement )
+        ,m_a                  ( m_executor, num_elements, 0.0, first_touch, huge_pages )
+        ,m_b                  ( m_executor, num_elements, 1.0, first_touch, huge_pages )
+        ,m_c                  ( m_executor, num_elements, 2.0, first_touch, huge_pages )
+    {
+        m_type_string += "[";
+        m_type_string += std::to_string(m_num_threads);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_elements);
+        m_type_string += ", ";
+        m_type_string += std::to_string(m_num_iterations);
+        m_type_string += "]";
+    }
+
+    virtual const string testCaseSpecificOutput() {
+
+        const double bytes = 3.0 * sizeof( double ) * m_num_elements * m_num_iterations;
+        return "bandwidth: " + to_string( bytes / m_mean_times / 1.0e9 ) + " [GB/s]";
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < m_num_iterations; i++ ) {
+
+            m_executor.parallel_for( (size_t)0, m_num_elements, [&]( const size_t j ) {
+                m_a[j] = m_b[j] + 3.0 * m_c[j];
+            } );
+        }
+    }
+
+    virtual ~FirstTouchBandwidth() {;}
+};
+
+
+class ParallelSchedulerNaive : public TestCaseWithTimeMeasurements {
+
+    const int m_num_threads;
+    const int m_num_iteration;
 
   public:
 
@@ -533,34 +1381,225 @@ class ParallelSchedulerNaive : public TestCaseWithTimeMeasurements {
 };
 
 
+/**
+ * ArrivalMonitor on the fan-in of an elastic ParallelExecutor. The workers deactivated for a
+ * while must be expected again in the phases after they are reactivated: 4 -> 2 -> 4 workers.
+ *
+ * @return true if the last phase has the arrivals of all the 4 workers.
+ */
+static bool checkElasticArrivalMonitor() {
+
+    const int        NUM_WORKERS = 4;
+    ParallelExecutor executor( NUM_WORKERS, WaitPolicy(), g_placement );
+    ArrivalMonitor   monitor( NUM_WORKERS );
+
+    executor.setArrivalMonitor( &monitor );
+
+    for ( const int num_active : { 4, 2, 4 } ) {
+
+        executor.setNumActiveWorkers( num_active );
+        for ( int i = 0; i < 5; i++ ) {
+            executor.run( []( const int ) {;} );
+        }
+    }
+    executor.setArrivalMonitor( nullptr );
+
+    const auto report = monitor.lastPhase();
+
+    if ( monitor.numPhases() != 15 || report.m_arrival_order.size() != NUM_WORKERS || !report.m_missing.empty() ) {
+        cerr << "elastic arrival monitor: " << report.summary() << "\n";
+        return false;
+    }
+    return true;
+}
+
+
 static const size_t NUM_TRIALS       = 10;
 static const size_t NUM_OSCILLATIONS = 100;
 static const size_t NUM_ITERATIONS_PARALLEL = 10000;
+static const size_t NUM_ITERATIONS_SKEWED   = 100;
+static const size_t NUM_ITERATIONS_STREAM   = 20;
+static const size_t NUM_ELEMENTS_STREAM     = 1 << 22;
+static const size_t NUM_LATENCY_SAMPLES     = 1000;
 
 int main( int argc, char* argv[] ) {
 
+    // usage: test_cpu_parallel_processing [none|compact|scatter|one_per_core] [--json=<file>] [--csv=<file>]
+    string json_path;
+    string csv_path;
+
+    if ( !parseCommandLine( argc, argv, json_path, csv_path ) ) {
+        return 1;
+    }
+
+    if ( !checkElasticArrivalMonitor() ) {
+        return 1;
+    }
+
     TestExecutor e( NUM_TRIALS );
 
-    e.addTestCase( make_shared< CyclicScheduler >             (   2, NUM_OSCILLATIONS ) );
-    e.addTestCase( make_shared< CyclicScheduler >             (   3, NUM_OSCILLATIONS ) );
-    e.addTestCase( make_shared< CyclicScheduler >             (   5, NUM_OSCILLATIONS ) );
-    e.addTestCase( make_shared< CyclicScheduler >             (  10, NUM_OSCILLATIONS ) );
-    e.addTestCase( make_shared< CyclicScheduler >             ( 100, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleCondVar > >( "condvar",   2, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleCondVar > >( "condvar",   3, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleCondVar > >( "condvar",   5, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleCondVar > >( "condvar",  10, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleCondVar > >( "condvar", 100, NUM_OSCILLATIONS ) );
+
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleFutex   > >( "futex",     2, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleFutex   > >( "futex",     3, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleFutex   > >( "futex",     5, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleFutex   > >( "futex",    10, NUM_OSCILLATIONS ) );
+    e.addTestCase( make_shared< CyclicScheduler< WaitNotifySingleFutex   > >( "futex",   100, NUM_OSCILLATIONS ) );
+
+    e.addTestCase( make_shared< NotifyToWakeLatency< WaitNotifySingleCondVar > >( "condvar", NUM_LATENCY_SAMPLES ) );
+    e.addTestCase( make_shared< NotifyToWakeLatency< WaitNotifySingleFutex   > >( "futex",   NUM_LATENCY_SAMPLES ) );
+
+    e.addTestCase( make_shared< PipelinedScheduler >(  4,  1, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PipelinedScheduler >(  4,  4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PipelinedScheduler >(  4, 16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PipelinedScheduler >( 10,  1, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PipelinedScheduler >( 10, 16, NUM_ITERATIONS_PARALLEL ) );
+
+    e.addTestCase( make_shared< SPSCChannelStream >(   16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< SPSCChannelStream >( 1024, NUM_ITERATIONS_PARALLEL ) );
 
     e.addTestCase( make_shared< ParallelSchedulerNaive >      (   4, NUM_ITERATIONS_PARALLEL ) );
     e.addTestCase( make_shared< ParallelSchedulerNaive >      (  16, NUM_ITERATIONS_PARALLEL ) );
     e.addTestCase( make_shared< ParallelSchedulerNaive >      (  64, NUM_ITERATIONS_PARALLEL ) );
 
-    e.addTestCase( make_shared< ParallelSchedulerWithPooling >(   4, NUM_ITERATIONS_PARALLEL ) );
-    e.addTestCase( make_shared< ParallelSchedulerWithPooling >(  16, NUM_ITERATIONS_PARALLEL ) );
-    e.addTestCase( make_shared< ParallelSchedulerWithPooling >(  64, NUM_ITERATIONS_PARALLEL ) );
+    using Pooling     = ParallelSchedulerWithPooling< WaitNotifyMultipleWaiters,         WaitNotifyMultipleNotifiers >;
+    using PoolingSpin = ParallelSchedulerWithPooling< SpinWaitNotifyMultipleWaiters,     SpinWaitNotifyMultipleNotifiers >;
+    using PoolingTree = ParallelSchedulerWithPooling< WakeTreeWaitNotifyMultipleWaiters, WaitNotifyMultipleNotifiers >;
+    using PoolingComb = ParallelSchedulerWithPooling< WakeTreeWaitNotifyMultipleWaiters, CombiningWaitNotifyMultipleNotifiers >;
+    using PoolingCTre = ParallelSchedulerWithPooling< WakeTreeWaitNotifyMultipleWaiters, CombiningTreeOf8 >;
+
+    e.addTestCase( make_shared< Pooling     >( "condvar",   4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< Pooling     >( "condvar",  16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< Pooling     >( "condvar",  64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingSpin >( "spin-only", 4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingSpin >( "spin-only",16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingSpin >( "spin-only",64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingTree >( "wake-tree", 4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingTree >( "wake-tree",16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingTree >( "wake-tree",64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingComb >( "wake-tree + combining", 4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingComb >( "wake-tree + combining",16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingComb >( "wake-tree + combining",64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingCTre >( "wake-tree + combining tree of 8",16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< PoolingCTre >( "wake-tree + combining tree of 8",64, NUM_ITERATIONS_PARALLEL ) );
+
+    e.addTestCase( make_shared< ParallelForWithExecutor >(  4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelForWithExecutor >( 16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelForWithExecutor >( 64, NUM_ITERATIONS_PARALLEL ) );
+
+    for ( auto elastic : { false, true } ) {
+
+        e.addTestCase( make_shared< ParallelForElastic >( elastic,  4, NUM_ITERATIONS_PARALLEL ) );
+        e.addTestCase( make_shared< ParallelForElastic >( elastic, 16, NUM_ITERATIONS_PARALLEL ) );
+        e.addTestCase( make_shared< ParallelForElastic >( elastic, 64, NUM_ITERATIONS_PARALLEL ) );
+    }
+
+    e.addTestCase( make_shared< ParallelReduceWithExecutor >(  4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelReduceWithExecutor >( 16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelReduceWithExecutor >( 64, NUM_ITERATIONS_PARALLEL ) );
+
+    e.addTestCase( make_shared< ParallelScanWithExecutor >(  4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelScanWithExecutor >( 16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelScanWithExecutor >( 64, NUM_ITERATIONS_PARALLEL ) );
+
+    e.addTestCase( make_shared< ParallelSchedulerWithTaskGraph >(  4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelSchedulerWithTaskGraph >( 16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< ParallelSchedulerWithTaskGraph >( 64, NUM_ITERATIONS_PARALLEL ) );
 
-    e.addTestCase( make_shared< ParallelSchedulerWithPoolingWithMidSync >(    4, NUM_ITERATIONS_PARALLEL ) );
-    e.addTestCase( make_shared< ParallelSchedulerWithPoolingWithMidSync >(   16, NUM_ITERATIONS_PARALLEL ) );
-    e.addTestCase( make_shared< ParallelSchedulerWithPoolingWithMidSync >(   64, NUM_ITERATIONS_PARALLEL ) );
+    for ( auto use_arena : { false, true } ) {
+
+        e.addTestCase( make_shared< ScratchPerDispatch >( use_arena,  4, NUM_ITERATIONS_PARALLEL ) );
+        e.addTestCase( make_shared< ScratchPerDispatch >( use_arena, 16, NUM_ITERATIONS_PARALLEL ) );
+        e.addTestCase( make_shared< ScratchPerDispatch >( use_arena, 64, NUM_ITERATIONS_PARALLEL ) );
+    }
+
+    for ( auto first_touch : { FirstTouch::MASTER, FirstTouch::WORKERS } ) {
+
+        e.addTestCase( make_shared< FirstTouchBandwidth >( first_touch, HugePages::NORMAL,      16, NUM_ELEMENTS_STREAM, NUM_ITERATIONS_STREAM ) );
+        e.addTestCase( make_shared< FirstTouchBandwidth >( first_touch, HugePages::TRANSPARENT, 16, NUM_ELEMENTS_STREAM, NUM_ITERATIONS_STREAM ) );
+    }
+
+    for ( auto schedule : { ParallelExecutor::Schedule::STATIC,
+                            ParallelExecutor::Schedule::DYNAMIC,
+                            ParallelExecutor::Schedule::GUIDED,
+                            ParallelExecutor::Schedule::STEALING } ) {
+
+        e.addTestCase( make_shared< ParallelForSkewed >( schedule,  4, NUM_ITERATIONS_SKEWED ) );
+        e.addTestCase( make_shared< ParallelForSkewed >( schedule, 16, NUM_ITERATIONS_SKEWED ) );
+    }
+
+    using MidSync     = ParallelSchedulerWithPoolingWithMidSync< WaitNotifyMultipleWaiters,
+                                                                 WaitNotifyMultipleNotifiers,
+                                                                 WaitNotifyEachOther >;
+    using MidSyncSpin = ParallelSchedulerWithPoolingWithMidSync< SpinWaitNotifyMultipleWaiters,
+                                                                 SpinWaitNotifyMultipleNotifiers,
+                                                                 SpinWaitNotifyEachOther >;
+    using MidSyncSR   = ParallelSchedulerWithPoolingWithMidSync< WaitNotifyMultipleWaiters,
+                                                                 WaitNotifyMultipleNotifiers,
+                                                                 SenseReversingWaitNotifyEachOther >;
+    using MidSyncDiss = ParallelSchedulerWithPoolingWithMidSync< WaitNotifyMultipleWaiters,
+                                                                 WaitNotifyMultipleNotifiers,
+                                                                 DisseminationWaitNotifyEachOther >;
+    using MidSyncTour = ParallelSchedulerWithPoolingWithMidSync< WaitNotifyMultipleWaiters,
+                                                                 WaitNotifyMultipleNotifiers,
+                                                                 TournamentWaitNotifyEachOther >;
+    using MidSyncHier = ParallelSchedulerWithPoolingWithMidSync< WaitNotifyMultipleWaiters,
+                                                                 WaitNotifyMultipleNotifiers,
+                                                                 HierarchicalWaitNotifyEachOther >;
+
+    e.addTestCase( make_shared< MidSync     >( "condvar",   4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSync     >( "condvar",  16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSync     >( "condvar",  64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncSpin >( "spin-only", 4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncSpin >( "spin-only",16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncSpin >( "spin-only",64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncSR   >( "sense-reversing", 4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncSR   >( "sense-reversing",16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncSR   >( "sense-reversing",64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncDiss >( "dissemination",   4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncDiss >( "dissemination",  16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncDiss >( "dissemination",  64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncTour >( "tournament",      4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncTour >( "tournament",     16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncTour >( "tournament",     64, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncHier >( "hierarchical",    4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncHier >( "hierarchical",   16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< MidSyncHier >( "hierarchical",   64, NUM_ITERATIONS_PARALLEL ) );
+
+    e.addTestCase( make_shared< HierarchicalSyncLevels >(  4, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< HierarchicalSyncLevels >( 16, NUM_ITERATIONS_PARALLEL ) );
+    e.addTestCase( make_shared< HierarchicalSyncLevels >( 64, NUM_ITERATIONS_PARALLEL ) );
+
+    using FanOutWake     = FanOutWakeLatency< WaitNotifyMultipleWaiters,         WaitNotifyMultipleNotifiers >;
+    using FanOutWakeSpin = FanOutWakeLatency< SpinWaitNotifyMultipleWaiters,     SpinWaitNotifyMultipleNotifiers >;
+    using FanOutWakeTree = FanOutWakeLatency< WakeTreeWaitNotifyMultipleWaiters, CombiningWaitNotifyMultipleNotifiers >;
+
+    for ( const int n : { 4, 16, 64 } ) {
+        e.addTestCase( make_shared< FanOutWake     >( "condvar",   n, NUM_LATENCY_SAMPLES ) );
+        e.addTestCase( make_shared< FanOutWakeSpin >( "spin-only", n, NUM_LATENCY_SAMPLES ) );
+        e.addTestCase( make_shared< FanOutWakeTree >( "wake-tree", n, NUM_LATENCY_SAMPLES ) );
+    }
+
+    for ( const int n : { 4, 16, 64 } ) {
+        e.addTestCase( make_shared< BarrierReleaseLatency< WaitNotifyEachOther               > >( "condvar",         n, NUM_LATENCY_SAMPLES ) );
+        e.addTestCase( make_shared< BarrierReleaseLatency< SenseReversingWaitNotifyEachOther > >( "sense-reversing", n, NUM_LATENCY_SAMPLES ) );
+        e.addTestCase( make_shared< BarrierReleaseLatency< DisseminationWaitNotifyEachOther  > >( "dissemination",   n, NUM_LATENCY_SAMPLES ) );
+        e.addTestCase( make_shared< BarrierReleaseLatency< TournamentWaitNotifyEachOther     > >( "tournament",      n, NUM_LATENCY_SAMPLES ) );
+    }
 
     e.execute();
 
+    if ( !json_path.empty() ) {
+        e.writeJson( json_path );
+    }
+    if ( !csv_path.empty() ) {
+        e.writeCsv( csv_path );
+    }
+
     return 0;
 }
 
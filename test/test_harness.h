@@ -0,0 +1,474 @@
+#ifndef __TEST_HARNESS_H__
+#define __TEST_HARNESS_H__
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "cpu_topology.h"
+#include "trace_recorder.h"
+
+using namespace std;
+
+/**
+ * The benchmark harness shared by the test programs.
+ */
+
+
+// Placement of the threads created by the test cases. It is given in the command line.
+static CpuPlacement g_placement = CpuPlacement::NONE;
+
+static void placeThreads( vector< thread >& threads ) {
+
+    if ( g_placement == CpuPlacement::NONE ) {
+        return;
+    }
+    const auto cpus = CpuTopology().placement( g_placement, threads.size() );
+
+    for ( size_t i = 0; i < threads.size(); i++ ) {
+        pinThreadToCpu( threads[i], cpus[i] );
+    }
+}
+
+
+/**
+ * Log-linear histogram of latencies in nanoseconds in the manner of HdrHistogram.
+ * The values below 2^SUB_BUCKET_BITS are counted exactly, and each power-of-2 range
+ * above is split into 2^SUB_BUCKET_BITS buckets, i.e., the relative error is < 1/32.
+ */
+class LatencyHistogram {
+
+    static const int      SUB_BUCKET_BITS = 5;
+    static const int      SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+    static const int      MAX_BITS        = 40;  // ~18 minutes
+    static const int      NUM_BUCKETS     = SUB_BUCKETS + ( MAX_BITS - SUB_BUCKET_BITS ) * SUB_BUCKETS;
+
+    vector< uint64_t >    m_counts;
+    uint64_t              m_count;
+    int64_t               m_min;
+    int64_t               m_max;
+    double                m_sum;
+
+    static int bucketIndex( const int64_t v ) {
+
+        if ( v < SUB_BUCKETS ) {
+            return max( (int64_t)0, v );
+        }
+        int msb = 63;
+        while ( ( ( v >> msb ) & 1 ) == 0 ) {
+            msb--;
+        }
+        if ( msb >= MAX_BITS ) {
+            return NUM_BUCKETS - 1;
+        }
+        const int shift = msb - SUB_BUCKET_BITS;
+        return SUB_BUCKETS + shift * SUB_BUCKETS + (int)( ( v >> shift ) - SUB_BUCKETS );
+    }
+
+    static int64_t bucketLowerBound( const int index ) {
+
+        if ( index < SUB_BUCKETS ) {
+            return index;
+        }
+        const int shift = ( index - SUB_BUCKETS ) / SUB_BUCKETS;
+        const int sub   = ( index - SUB_BUCKETS ) % SUB_BUCKETS;
+        return (int64_t)( SUB_BUCKETS + sub ) << shift;
+    }
+
+    static int64_t bucketUpperBound( const int index ) {
+        return index + 1 < NUM_BUCKETS ? bucketLowerBound( index + 1 ) - 1 : INT64_MAX;
+    }
+
+  public:
+
+    LatencyHistogram()
+        :m_counts ( NUM_BUCKETS, 0 )
+        ,m_count  ( 0 )
+        ,m_min    ( INT64_MAX )
+        ,m_max    ( 0 )
+        ,m_sum    ( 0.0 )
+    {;}
+
+    inline void record( const int64_t nanoseconds ) {
+
+        m_counts[ bucketIndex( nanoseconds ) ]++;
+        m_count++;
+        m_min  = min( m_min, nanoseconds );
+        m_max  = max( m_max, nanoseconds );
+        m_sum += nanoseconds;
+    }
+
+    void merge( const LatencyHistogram& other ) {
+
+        for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_min    = min( m_min, other.m_min );
+        m_max    = max( m_max, other.m_max );
+        m_sum   += other.m_sum;
+    }
+
+    void clear() { *this = LatencyHistogram(); }
+
+    uint64_t count()    const { return m_count; }
+    int64_t  maxValue() const { return m_max; }
+    double   mean()     const { return m_count == 0 ? 0.0 : m_sum / m_count; }
+
+    /**
+     * @brief the value at the percentile. It is the upper bound of the bucket, capped by the max.
+     *
+     * @param percentile (in): in [0, 100].
+     */
+    int64_t valueAtPercentile( const double percentile ) const {
+
+        if ( m_count == 0 ) {
+            return 0;
+        }
+        const uint64_t rank = max( (uint64_t)1, (uint64_t)ceil( percentile / 100.0 * m_count ) );
+
+        uint64_t cumulative = 0;
+        for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+            cumulative += m_counts[i];
+            if ( cumulative >= rank ) {
+                return min( bucketUpperBound( i ), m_max );
+            }
+        }
+        return m_max;
+    }
+
+    const string summary() const {
+
+        stringstream ss;
+        ss << "p50: "    << valueAtPercentile( 50.0 ) << " [ns]\t"
+           << "p90: "    << valueAtPercentile( 90.0 ) << " [ns]\t"
+           << "p99: "    << valueAtPercentile( 99.0 ) << " [ns]\t"
+           << "p99.9: "  << valueAtPercentile( 99.9 ) << " [ns]\t"
+           << "max: "    << m_max << " [ns]";
+        return ss.str();
+    }
+
+    /**
+     * @brief the statistics and the non-empty buckets as a JSON object.
+     */
+    const string json() const {
+
+        stringstream ss;
+        ss << "{ \"count\": " << m_count
+           << ", \"min\": "   << ( m_count == 0 ? 0 : m_min )
+           << ", \"mean\": "  << mean()
+           << ", \"p50\": "   << valueAtPercentile( 50.0 )
+           << ", \"p90\": "   << valueAtPercentile( 90.0 )
+           << ", \"p99\": "   << valueAtPercentile( 99.0 )
+           << ", \"p99.9\": " << valueAtPercentile( 99.9 )
+           << ", \"max\": "   << m_max
+           << ", \"buckets\": [";
+
+        bool first = true;
+        for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+            if ( m_counts[i] > 0 ) {
+                ss << ( first ? " " : ", " ) << "[" << bucketLowerBound( i ) << ", "
+                   << bucketUpperBound( i ) << ", " << m_counts[i] << "]";
+                first = false;
+            }
+        }
+        ss << " ] }";
+        return ss.str();
+    }
+};
+
+
+/**
+ * @brief timestamp for the latency measurements in nanoseconds.
+ */
+static inline int64_t nowNanoseconds() {
+
+    return chrono::duration_cast< chrono::nanoseconds >(
+               chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+class TestCaseWithTimeMeasurements {
+
+  protected:
+    string           m_type_string;
+    vector<double>   m_measured_times;
+    double           m_mean_times;
+    double           m_stddev_times;
+    LatencyHistogram m_latencies;
+
+  public:
+
+    TestCaseWithTimeMeasurements( const string type )
+        :m_type_string        ( type  )
+        ,m_mean_times         ( 0.0   )
+        ,m_stddev_times       ( 0.0   )
+    {;}
+
+
+    virtual ~TestCaseWithTimeMeasurements(){;}
+
+    void addTime( const double microseconds ) {
+
+        m_measured_times.push_back( microseconds );
+    }
+
+    const string testType() { return m_type_string; }
+
+    virtual const string testCaseSpecificOutput() { return ""; }
+
+    /**
+     * @brief the test cases that measure the individual latencies move their samples
+     *        of the last run into histogram, and clear them. Called after each run.
+     */
+    virtual void collectLatencies( LatencyHistogram& histogram ) {;}
+
+    void collectLatenciesOfRun( const bool discard ) {
+
+        if ( discard ) {
+            LatencyHistogram discarded;
+            collectLatencies( discarded );
+        }
+        else {
+            collectLatencies( m_latencies );
+        }
+    }
+
+    const LatencyHistogram& latencies() const { return m_latencies; }
+
+    double meanTime()   const { return m_mean_times;   }
+    double stddevTime() const { return m_stddev_times; }
+
+    void calculateMeanStddevOfTime() {
+
+        m_mean_times = 0.0;
+
+        const double len = m_measured_times.size();
+
+        for ( auto v : m_measured_times ) {
+            m_mean_times += v;
+        }
+
+        m_mean_times /= len;
+
+        m_stddev_times = 0.0;
+
+        for ( auto v : m_measured_times ) {
+
+            const double diff = v - m_mean_times;
+            const double sq   = diff * diff;
+            m_stddev_times += sq;
+        }
+        m_stddev_times = sqrt( m_stddev_times / ( len - 1 ) );
+    }
+
+    virtual void print( const string preamble ) {
+        cout << setprecision(4);
+        cout << "RESULT";
+        cout << "\t";
+        cout << preamble;
+        cout << "\t";
+        cout << m_type_string;
+        cout << "\t";
+        cout << "mean: " << (m_mean_times * 1000.0) << " [ms]" ;
+        cout << "\t";
+        cout << "stddev: " << (m_stddev_times * 1000.0) << " [ms]" ;
+        cout << "\t";
+        cout << testCaseSpecificOutput();
+        if ( m_latencies.count() > 0 ) {
+            cout << "\t";
+            cout << m_latencies.summary();
+        }
+        cout << "\n";
+    }
+
+    virtual void run() = 0;
+};
+
+class TestExecutor {
+
+  protected:
+    vector< shared_ptr< TestCaseWithTimeMeasurements > > m_test_cases;
+
+    const int m_num_trials;
+
+    // writes the string in a quoted CSV field, with the embedded quotes doubled.
+    static void writeCsvQuoted( ostream& os, const string& s ) {
+
+        os << '"';
+        for ( const char c : s ) {
+            if ( c == '"' ) {
+                os << '"';
+            }
+            os << c;
+        }
+        os << '"';
+    }
+
+  public:
+    TestExecutor( const int num_trials )
+        :m_num_trials( num_trials ) {;}
+
+    virtual ~TestExecutor(){;}
+
+    void addTestCase( shared_ptr< TestCaseWithTimeMeasurements>&& c ) {
+        m_test_cases.emplace_back( c );
+    }
+
+    virtual void   prepareForBatchRuns   ( const int test_case ){;}
+    virtual void   cleanupAfterBatchRuns ( const int test_case ){;}
+    virtual void   prepareForRun         ( const int test_case, const int num ){;}
+    virtual void   cleanupAfterRun       ( const int test_case, const int num ){;}
+
+    virtual const string preamble () { return ""; }
+
+    void execute() {
+
+        for ( size_t i = 0; i < m_test_cases.size(); i++ ) {
+
+            auto test_case = m_test_cases[i];
+
+            cout << "Testing [" << test_case->testType() << "] ";
+
+            prepareForBatchRuns(i);
+
+            for ( int j = 0; j < m_num_trials + 1; j++ ) {
+
+                cout << "." << flush;
+
+                prepareForRun(i, j);
+
+                auto time_begin = chrono::high_resolution_clock::now();        
+
+                test_case->run();
+
+                auto time_end = chrono::high_resolution_clock::now();        
+
+                cleanupAfterRun(i, j);
+
+                chrono::duration<double> time_diff = time_end - time_begin;
+
+                if (j > 0) {
+                    // discard the first run.
+                    test_case->addTime( time_diff.count() );
+                }
+                test_case->collectLatenciesOfRun( j == 0 );
+            }
+            cout << "\n";
+
+            cleanupAfterBatchRuns(i);
+           
+        }
+
+        for ( size_t i = 0; i < m_test_cases.size(); i++ ) {
+
+            auto t = m_test_cases[i];
+
+            t->calculateMeanStddevOfTime();
+
+            t->print( preamble() );
+        }
+    }
+
+    /**
+     * @brief writes the results to a JSON file as an array of the test cases.
+     */
+    void writeJson( const string& path ) {
+
+        ofstream ofs( path );
+
+        ofs << "[\n";
+        for ( size_t i = 0; i < m_test_cases.size(); i++ ) {
+
+            const auto& t = m_test_cases[i];
+
+            ofs << "  { \"test\": \"";
+            writeJsonEscaped( ofs, t->testType() );
+            ofs << "\""
+                << ", \"mean_ms\": "   << t->meanTime()   * 1000.0
+                << ", \"stddev_ms\": " << t->stddevTime() * 1000.0;
+
+            if ( t->latencies().count() > 0 ) {
+                ofs << ", \"latency_ns\": " << t->latencies().json();
+            }
+            ofs << " }" << ( i + 1 < m_test_cases.size() ? "," : "" ) << "\n";
+        }
+        ofs << "]\n";
+    }
+
+    /**
+     * @brief writes the results to a CSV file, one line per test case.
+     *        The latency columns are empty for the test cases without the latency measurements.
+     */
+    void writeCsv( const string& path ) {
+
+        ofstream ofs( path );
+
+        ofs << "test,mean_ms,stddev_ms,count,p50_ns,p90_ns,p99_ns,p99.9_ns,max_ns\n";
+
+        for ( const auto& t : m_test_cases ) {
+
+            writeCsvQuoted( ofs, t->testType() );
+            ofs << "," << t->meanTime() * 1000.0 << "," << t->stddevTime() * 1000.0 << ",";
+
+            const auto& l = t->latencies();
+            if ( l.count() > 0 ) {
+                ofs << l.count() << "," << l.valueAtPercentile( 50.0 ) << "," << l.valueAtPercentile( 90.0 ) << ","
+                    << l.valueAtPercentile( 99.0 ) << "," << l.valueAtPercentile( 99.9 ) << "," << l.maxValue() << "\n";
+            }
+            else {
+                ofs << ",,,,,\n";
+            }
+        }
+    }
+};
+
+
+/**
+ * @brief parses the command line arguments common to the test programs.
+ *        [none|compact|scatter|one_per_core] [--json=<file>] [--csv=<file>]
+ *
+ * @return false if an argument is unknown.
+ */
+static bool parseCommandLine( int argc, char* argv[], string& json_path, string& csv_path ) {
+
+    for ( int i = 1; i < argc; i++ ) {
+
+        const string arg( argv[i] );
+
+        if ( arg.rfind( "--json=", 0 ) == 0 ) {
+            json_path = arg.substr( 7 );
+            continue;
+        }
+        if ( arg.rfind( "--csv=", 0 ) == 0 ) {
+            csv_path = arg.substr( 6 );
+            continue;
+        }
+        if ( arg == "compact" ) {
+            g_placement = CpuPlacement::COMPACT;
+        }
+        else if ( arg == "scatter" ) {
+            g_placement = CpuPlacement::SCATTER;
+        }
+        else if ( arg == "one_per_core" ) {
+            g_placement = CpuPlacement::ONE_PER_CORE;
+        }
+        else if ( arg != "none" ) {
+            cerr << "unknown argument: " << arg << "\n";
+            return false;
+        }
+        CpuTopology topology;
+        cout << "placement: " << arg << "\tcpus: " << topology.numCpus()
+             << "\tcores: " << topology.numCores() << "\tnodes: " << topology.numNodes() << "\n";
+    }
+    return true;
+}
+
+#endif /*__TEST_HARNESS_H__*/
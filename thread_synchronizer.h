@@ -8,13 +8,484 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <new>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+#include "cache_line.h"
+#include "cpu_topology.h"
+#include "trace_recorder.h"
+#include "arrival_monitor.h"
 
 using namespace std;
 
+#if defined(__cpp_lib_atomic_wait)
+#define THREAD_SYNCHRONIZER_HAS_ATOMIC_WAIT
+#endif
+
+/**
+ * Hot-path counters of a synchronizer for one thread, or the sum over the threads.
+ */
+struct SyncCounters {
+
+    uint64_t m_num_spins;              // polls of the condition in the spin loops
+    uint64_t m_num_blocking_waits;     // times the thread parked on the condition variable or the futex
+    uint64_t m_num_spurious_wakeups;   // times the thread woke up from the park and had to park again
+    uint64_t m_num_lock_acquisitions;  // mutex::lock() calls
+    uint64_t m_lock_wait_ns;           // total time in mutex::lock()
+    uint64_t m_num_wakeups;            // returns from wait() or syncThreads() on a notification
+    uint64_t m_notify_to_wake_ns;      // total time from the notification to the returns
+    uint64_t m_max_notify_to_wake_ns;
+
+    SyncCounters()
+        :m_num_spins             ( 0 )
+        ,m_num_blocking_waits    ( 0 )
+        ,m_num_spurious_wakeups  ( 0 )
+        ,m_num_lock_acquisitions ( 0 )
+        ,m_lock_wait_ns          ( 0 )
+        ,m_num_wakeups           ( 0 )
+        ,m_notify_to_wake_ns     ( 0 )
+        ,m_max_notify_to_wake_ns ( 0 )
+        {;}
+
+    SyncCounters& operator+=( const SyncCounters& rhs ) {
+
+        m_num_spins             += rhs.m_num_spins;
+        m_num_blocking_waits    += rhs.m_num_blocking_waits;
+        m_num_spurious_wakeups  += rhs.m_num_spurious_wakeups;
+        m_num_lock_acquisitions += rhs.m_num_lock_acquisitions;
+        m_lock_wait_ns          += rhs.m_lock_wait_ns;
+        m_num_wakeups           += rhs.m_num_wakeups;
+        m_notify_to_wake_ns     += rhs.m_notify_to_wake_ns;
+        m_max_notify_to_wake_ns  = max( m_max_notify_to_wake_ns, rhs.m_max_notify_to_wake_ns );
+        return *this;
+    }
+};
+
+
+#ifdef THREAD_SYNCHRONIZER_ENABLE_COUNTERS
+/**
+ * Per-instance, per-thread hot-path counters built into each synchronizer below.
+ * It is compiled in only if THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined before
+ * including this file. Otherwise it is an empty class whose methods do nothing.
+ *
+ * Each thread counts into its own slot on its own cache line. The slot is the thread_id
+ * for the methods that take one, and the threads without a thread_id (the notifier of a
+ * fan-out, the waiter of a fan-in) have their own slots after them. See counters() of each class.
+ * The counters are updated with relaxed atomics, so that they can be polled with
+ * snapshot() and cleared with reset() while the threads are running.
+ */
+class SyncCounterSet {
+
+    struct Slot {
+        atomic<uint64_t> m_num_spins;
+        atomic<uint64_t> m_num_blocking_waits;
+        atomic<uint64_t> m_num_spurious_wakeups;
+        atomic<uint64_t> m_num_lock_acquisitions;
+        atomic<uint64_t> m_lock_wait_ns;
+        atomic<uint64_t> m_num_wakeups;
+        atomic<uint64_t> m_notify_to_wake_ns;
+        atomic<uint64_t> m_max_notify_to_wake_ns;
+    };
+
+    vector< CacheLineAligned< Slot > > m_slots;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic<uint64_t> m_notify_time;
+
+    static inline uint64_t now() {
+        return chrono::duration_cast< chrono::nanoseconds >( chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    static inline void add( atomic<uint64_t>& counter, const uint64_t value ) {
+        counter.fetch_add( value, memory_order_relaxed );
+    }
+
+  public:
+
+    /**
+     * Predicate that counts the polls of the wrapped predicate as spins.
+     */
+    template< class PRED >
+    class SpinCounter {
+
+        atomic<uint64_t>& m_count;
+        PRED              m_pred;
+
+      public:
+        SpinCounter( atomic<uint64_t>& count, PRED pred ) : m_count( count ), m_pred( pred ) {;}
+
+        inline bool operator()() {
+            add( m_count, 1 );
+            return m_pred();
+        }
+    };
+
+    /**
+     * Predicate for the park loops. The first false is a blocking wait,
+     * and each false after it is a spurious wakeup.
+     */
+    template< class PRED >
+    class ParkCounter {
+
+        Slot& m_slot;
+        PRED  m_pred;
+        bool  m_parked;
+
+      public:
+        ParkCounter( Slot& slot, PRED pred ) : m_slot( slot ), m_pred( pred ), m_parked( false ) {;}
+
+        inline bool operator()() {
+            const bool done = m_pred();
+            if ( !done ) {
+                add( m_parked ? m_slot.m_num_spurious_wakeups : m_slot.m_num_blocking_waits, 1 );
+                m_parked = true;
+            }
+            return done;
+        }
+    };
+
+    /**
+     * @param num_slots (in): number of the threads that use the synchronizer.
+     */
+    SyncCounterSet( const int num_slots )
+        :m_slots       ( num_slots )
+        ,m_notify_time ( 0 )
+    {
+        reset();
+    }
+
+    int numSlots() const { return (int)m_slots.size(); }
+
+    /**
+     * @brief wraps the predicate of a spin loop to count its polls.
+     */
+    template< class PRED >
+    inline SpinCounter< PRED > countSpins( const int slot, PRED pred ) {
+        return SpinCounter< PRED >( m_slots[ slot ].m_value.m_num_spins, pred );
+    }
+
+    /**
+     * @brief wraps the predicate of a condition variable wait or a futex park loop
+     *        to count the blocking waits and the spurious wakeups.
+     */
+    template< class PRED >
+    inline ParkCounter< PRED > countParks( const int slot, PRED pred ) {
+        return ParkCounter< PRED >( m_slots[ slot ].m_value, pred );
+    }
+
+    /**
+     * @brief counts one poll of a spin loop that does not take a predicate.
+     */
+    inline void addSpin( const int slot ) {
+        add( m_slots[ slot ].m_value.m_num_spins, 1 );
+    }
+
+    /**
+     * @brief counts one park in a loop that does not take a predicate.
+     *
+     * @param again (in): true if the thread has already parked in the same wait.
+     */
+    inline void addPark( const int slot, const bool again ) {
+        auto& s = m_slots[ slot ].m_value;
+        add( again ? s.m_num_spurious_wakeups : s.m_num_blocking_waits, 1 );
+    }
+
+    /**
+     * @brief locks the mutex and measures the time it takes.
+     */
+    inline void lock( const int slot, unique_lock<mutex>& lock ) {
+
+        const uint64_t start = now();
+        lock.lock();
+        auto& s = m_slots[ slot ].m_value;
+        add( s.m_num_lock_acquisitions, 1 );
+        add( s.m_lock_wait_ns, now() - start );
+    }
+
+    /**
+     * @brief records the time of the notification. Called by the notifier before the release.
+     */
+    inline void markNotify() {
+        m_notify_time.store( now(), memory_order_relaxed );
+    }
+
+    /**
+     * @brief counts a wakeup and its latency from the last markNotify().
+     */
+    inline void addWakeup( const int slot ) {
+
+        const uint64_t woken    = now();
+        const uint64_t notified = m_notify_time.load( memory_order_relaxed );
+        const uint64_t latency  = ( woken > notified ) ? woken - notified : 0;
+
+        auto& s = m_slots[ slot ].m_value;
+        add( s.m_num_wakeups,       1       );
+        add( s.m_notify_to_wake_ns, latency );
+
+        uint64_t current_max = s.m_max_notify_to_wake_ns.load( memory_order_relaxed );
+        while (    current_max < latency
+                && !s.m_max_notify_to_wake_ns.compare_exchange_weak( current_max, latency, memory_order_relaxed ) ) {;}
+    }
+
+    /**
+     * @brief the counters of the slot.
+     */
+    SyncCounters snapshot( const int slot ) const {
+
+        const auto&  s = m_slots[ slot ].m_value;
+        SyncCounters c;
+        c.m_num_spins             = s.m_num_spins.            load( memory_order_relaxed );
+        c.m_num_blocking_waits    = s.m_num_blocking_waits.   load( memory_order_relaxed );
+        c.m_num_spurious_wakeups  = s.m_num_spurious_wakeups. load( memory_order_relaxed );
+        c.m_num_lock_acquisitions = s.m_num_lock_acquisitions.load( memory_order_relaxed );
+        c.m_lock_wait_ns          = s.m_lock_wait_ns.         load( memory_order_relaxed );
+        c.m_num_wakeups           = s.m_num_wakeups.          load( memory_order_relaxed );
+        c.m_notify_to_wake_ns     = s.m_notify_to_wake_ns.    load( memory_order_relaxed );
+        c.m_max_notify_to_wake_ns = s.m_max_notify_to_wake_ns.load( memory_order_relaxed );
+        return c;
+    }
+
+    /**
+     * @brief the sum of the counters over all the slots.
+     */
+    SyncCounters snapshot() const {
+
+        SyncCounters total;
+        for ( int i = 0; i < numSlots(); i++ ) {
+            total += snapshot( i );
+        }
+        return total;
+    }
+
+    /**
+     * @brief clears all the counters.
+     */
+    void reset() {
+
+        for ( auto& slot : m_slots ) {
+            auto& s = slot.m_value;
+            s.m_num_spins.            store( 0, memory_order_relaxed );
+            s.m_num_blocking_waits.   store( 0, memory_order_relaxed );
+            s.m_num_spurious_wakeups. store( 0, memory_order_relaxed );
+            s.m_num_lock_acquisitions.store( 0, memory_order_relaxed );
+            s.m_lock_wait_ns.         store( 0, memory_order_relaxed );
+            s.m_num_wakeups.          store( 0, memory_order_relaxed );
+            s.m_notify_to_wake_ns.    store( 0, memory_order_relaxed );
+            s.m_max_notify_to_wake_ns.store( 0, memory_order_relaxed );
+        }
+    }
+};
+#else
+/**
+ * The counters compiled out. Each method is an empty inline function, and the predicates
+ * are passed through as they are, so the hot paths are the same as without the counters.
+ * snapshot() returns zeros. The members are declared [[no_unique_address]], so it takes
+ * no storage in the synchronizers.
+ */
+class SyncCounterSet {
+
+  public:
+
+    SyncCounterSet( const int ) {;}
+
+    int numSlots() const { return 0; }
+
+    template< class PRED >
+    inline PRED countSpins( const int, PRED pred ) { return pred; }
+
+    template< class PRED >
+    inline PRED countParks( const int, PRED pred ) { return pred; }
+
+    inline void addSpin( const int ) {;}
+
+    inline void addPark( const int, const bool ) {;}
+
+    inline void lock( const int, unique_lock<mutex>& lock ) { lock.lock(); }
+
+    inline void markNotify() {;}
+
+    inline void addWakeup( const int ) {;}
+
+    SyncCounters snapshot( const int ) const { return SyncCounters(); }
+
+    SyncCounters snapshot() const { return SyncCounters(); }
+
+    void reset() {;}
+};
+#endif
+
+
+/**
+ * Spin-then-park policy for the waiting loops in the synchronizers below.
+ * A waiter first spins num_spins times with a CPU pause hint,
+ * then backs off exponentially with pauses and yield() for num_backoffs rounds,
+ * and then parks on the condition variable (or the futex).
+ * The spin loops in notify(), which wait for the waiters to arrive, use the same
+ * pause & backoff but never park.
+ */
+class WaitPolicy {
+
+    int m_num_spins;
+    int m_num_backoffs;
+
+  public:
+
+    /**
+     * @param num_spins    (in): number of busy spins with a pause hint before backing off.
+     * @param num_backoffs (in): number of exponential backoff rounds with yield() before parking.
+     */
+    WaitPolicy( const int num_spins = 512, const int num_backoffs = 8 )
+        :m_num_spins    ( num_spins    )
+        ,m_num_backoffs ( num_backoffs )
+        {;}
+
+    /**
+     * @brief the policy that parks immediately, which was the only behavior before.
+     */
+    static WaitPolicy parkImmediately() { return WaitPolicy( 0, 0 ); }
+
+    /**
+     * @brief hints the CPU that the caller is in a spin loop.
+     */
+    static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__( "yield" );
+#endif
+    }
+
+    /**
+     * @brief spins until the predicate holds or the spin budget is exhausted.
+     *
+     * @return true if the predicate holds. false if the caller should park.
+     */
+    template< class PRED >
+    inline bool spinUntil( PRED pred ) const {
+
+        for ( int i = 0; i < m_num_spins; i++ ) {
+            if ( pred() ) {
+                return true;
+            }
+            cpuRelax();
+        }
+        for ( int i = 0; i < m_num_backoffs; i++ ) {
+            if ( pred() ) {
+                return true;
+            }
+            for ( int j = 0; j < ( 1 << i ); j++ ) {
+                cpuRelax();
+            }
+            this_thread::yield();
+        }
+        return pred();
+    }
+
+    /**
+     * @brief spins until the predicate holds without parking.
+     *        After the spin budget it keeps backing off with yield() in order not to
+     *        starve the thread it is waiting for, or its SMT sibling.
+     */
+    template< class PRED >
+    inline void busyWaitUntil( PRED pred ) const {
+
+        int count = 0;
+        while ( !pred() ) {
+            if ( count < m_num_spins ) {
+                cpuRelax();
+                count++;
+            }
+            else {
+                const int round = count - m_num_spins;
+                for ( int j = 0; j < ( 1 << round ); j++ ) {
+                    cpuRelax();
+                }
+                this_thread::yield();
+                if ( round < m_num_backoffs ) {
+                    // saturates at the longest back-off.
+                    count++;
+                }
+            }
+        }
+    }
+};
+
+
+/**
+ * 32-bit state word on which a thread can block until its value changes.
+ * It is backed by atomic::wait()/notify_*() of C++20, which is a futex on Linux,
+ * and falls back to a mutex & condition variable on older standard libraries.
+ */
+class AtomicWaitWord {
+
+    atomic<uint32_t>   m_word;
+
+#ifndef THREAD_SYNCHRONIZER_HAS_ATOMIC_WAIT
+    mutex              m_mutex;
+    condition_variable m_cond_var;
+#endif
+
+  public:
+    AtomicWaitWord( const uint32_t initial_value = 0 )
+        :m_word( initial_value )
+        {;}
+
+    /**
+     * @brief the underlying atomic word for the lock-free operations.
+     */
+    atomic<uint32_t>& word() { return m_word; }
+
+    /**
+     * @brief blocks as long as the word holds old_value.
+     *        It may return spuriously. The caller must re-check the word.
+     */
+    inline void waitWhileEqual( const uint32_t old_value ) {
+#ifdef THREAD_SYNCHRONIZER_HAS_ATOMIC_WAIT
+        m_word.wait( old_value, memory_order_acquire );
+#else
+        unique_lock<mutex> lock( m_mutex );
+        m_cond_var.wait( lock, [&] { return m_word.load( memory_order_acquire ) != old_value; } );
+#endif
+    }
+
+    /**
+     * @brief wakes up one thread blocking in waitWhileEqual() after the word has been changed.
+     */
+    inline void wakeOne() {
+#ifdef THREAD_SYNCHRONIZER_HAS_ATOMIC_WAIT
+        m_word.notify_one();
+#else
+        { lock_guard<mutex> lock( m_mutex ); }
+        m_cond_var.notify_one();
+#endif
+    }
+
+    /**
+     * @brief wakes up all the threads blocking in waitWhileEqual() after the word has been changed.
+     */
+    inline void wakeAll() {
+#ifdef THREAD_SYNCHRONIZER_HAS_ATOMIC_WAIT
+        m_word.notify_all();
+#else
+        { lock_guard<mutex> lock( m_mutex ); }
+        m_cond_var.notify_all();
+#endif
+    }
+};
+
+
 /**
  * Wait & notification mechanism for a single waiter & a single notifier.
+ * This is the backend with a mutex & a condition variable.
  */
-class WaitNotifySingle {
+class WaitNotifySingleCondVar {
+
+    static constexpr int WAITER_SLOT   = 0;
+    static constexpr int NOTIFIER_SLOT = 1;
 
     mutex              m_mutex;
     condition_variable m_cond_var;
@@ -23,14 +494,23 @@ class WaitNotifySingle {
 
     atomic_bool        m_terminating;
 
+    const WaitPolicy   m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
   public:
-    WaitNotifySingle()
+    /**
+     * @param wait_policy (in): spin-then-park policy for wait() and notify().
+     */
+    WaitNotifySingleCondVar( const WaitPolicy& wait_policy = WaitPolicy() )
         :m_cond_var_flag (false)
         ,m_waiting       (false)
         ,m_terminating   (false)
+        ,m_wait_policy   (wait_policy)
+        ,m_sync_counters (2)
         {;}
 
-    ~WaitNotifySingle(){
+    ~WaitNotifySingleCondVar(){
         terminate();
     }
 
@@ -41,6 +521,7 @@ class WaitNotifySingle {
 
         unique_lock<mutex> lock( m_mutex, defer_lock );
         lock.lock();
+        m_sync_counters.markNotify();
         m_terminating.store( true, memory_order_release );
         lock.unlock();
         m_cond_var.notify_one();
@@ -53,18 +534,28 @@ class WaitNotifySingle {
         return m_terminating.load( memory_order_acquire );
     }
 
+    /**
+     * @brief hot-path counters. Slot 0 is the waiter and slot 1 is the notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
     /** 
      * @brief give the waiting thread a go ahead.
      *        It also waits in a spin lock if the waiter is not yet in wait().
      */
     inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifySingleCondVar::notify" );
+
         if ( !m_terminating.load( memory_order_acquire ) ) {
 
             unique_lock<mutex> lock( m_mutex, defer_lock );
 
-            while(    !m_waiting.    load( memory_order_acquire )
-                   && !m_terminating.load( memory_order_acquire ) ) {;}
-            lock.lock();       
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( NOTIFIER_SLOT,
+                                         [&] { return    m_waiting.    load( memory_order_acquire )
+                                                      || m_terminating.load( memory_order_acquire ); } ) );
+            m_sync_counters.lock( NOTIFIER_SLOT, lock );
+            m_sync_counters.markNotify();
             m_waiting.      store( false, memory_order_release );
             m_cond_var_flag.store( true,  memory_order_release );
             lock.unlock();
@@ -76,454 +567,2352 @@ class WaitNotifySingle {
      * @brief waits until the notifier calls notify().
      */
     inline void wait() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifySingleCondVar::wait" );
+
         if ( !m_terminating.load( memory_order_acquire ) ) {
-            unique_lock<mutex> lock( m_mutex, defer_lock );
-            lock.lock();
+
             m_waiting.store( true, memory_order_release );
-            m_cond_var.wait( lock, [&] { return    m_cond_var_flag.load( memory_order_acquire )
-                                                || m_terminating.  load( memory_order_acquire ); } );
+
+            auto notified = [&] { return    m_cond_var_flag.load( memory_order_acquire )
+                                         || m_terminating.  load( memory_order_acquire ); };
+
+            if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( WAITER_SLOT, notified ) ) ) {
+
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                unique_lock<mutex> lock( m_mutex, defer_lock );
+                m_sync_counters.lock( WAITER_SLOT, lock );
+                m_cond_var.wait( lock, m_sync_counters.countParks( WAITER_SLOT, notified ) );
+                lock.unlock();
+            }
             m_cond_var_flag.store( false, memory_order_release );
-            lock.unlock();
+            m_sync_counters.addWakeup( WAITER_SLOT );
         }
     }
 };
 
 
 /**
- * Wait & notification mechanism for multiple waiters & a single notifier.
- * It is mainly used with WaitNotifyMultipleNotifiers to form a parallel
- * execution of a thread group.
+ * Wait & notification mechanism for a single waiter & a single notifier.
+ * This is the backend with a single state word on AtomicWaitWord.
+ * The notification is kept in the word until the waiter consumes it, and hence
+ * the notifier does not have to wait for the waiter to enter wait().
+ * The uncontended path is one atomic RMW on each side, and the kernel is entered
+ * only if the waiter is actually asleep.
  */
-class WaitNotifyMultipleWaiters {
+class WaitNotifySingleFutex {
 
-    mutex                m_mutex;
-    condition_variable   m_cond_var;
-    vector<atomic_bool*> m_cond_var_flags;
-    atomic_int           m_num_waiting;
+    static constexpr uint32_t NOTIFIED    = 0x1;
+    static constexpr uint32_t SLEEPING    = 0x2;
+    static constexpr uint32_t TERMINATING = 0x4;
 
-    atomic_bool          m_terminating;
+    static constexpr int WAITER_SLOT   = 0;
+    static constexpr int NOTIFIER_SLOT = 1;
 
-    const int            m_num_waiters;
+    AtomicWaitWord     m_state;
+
+    const WaitPolicy   m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
 
   public:
+    /**
+     * @param wait_policy (in): spin-then-park policy for wait() and notify().
+     */
+    WaitNotifySingleFutex( const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_state         ( 0 )
+        ,m_wait_policy   ( wait_policy )
+        ,m_sync_counters ( 2 )
+        {;}
+
+    ~WaitNotifySingleFutex(){
+        terminate();
+    }
+
+    /** 
+     * @brief lets the waiter know that it should terminate the thread execution.
+     */
+    void terminate() {
+
+        m_sync_counters.markNotify();
+        m_state.word().fetch_or( TERMINATING, memory_order_acq_rel );
+        m_state.wakeAll();
+    }
 
     /**
-     * @param num_waiters (in): number of waiters must be fixed at the construction
+     * @brief the waiter can check if it should terminate its execution.
      */
-    WaitNotifyMultipleWaiters( const int num_waiters )
-        :m_num_waiting   (0)
-        ,m_terminating   (false)
-        ,m_num_waiters   (num_waiters)
-    {
-        for ( int i = 0; i < m_num_waiters; i++ ) {
+    bool isTerminating() {
+        return ( m_state.word().load( memory_order_acquire ) & TERMINATING ) != 0;
+    }
 
-            m_cond_var_flags.emplace_back( new atomic_bool() );
-        }
+    /**
+     * @brief hot-path counters. Slot 0 is the waiter and slot 1 is the notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /** 
+     * @brief give the waiting thread a go ahead.
+     *        It waits in a spin lock if the previous notification has not been consumed yet.
+     */
+    inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifySingleFutex::notify" );
+
+        auto& word = m_state.word();
 
-        for ( int i = 0; i < m_num_waiters; i++ ) {
+        uint32_t state = word.load( memory_order_acquire );
 
-            m_cond_var_flags[i]->store( false,  memory_order_release );
+        while ( true ) {
+
+            if ( ( state & TERMINATING ) != 0 ) {
+                return;
+            }
+            if ( ( state & NOTIFIED ) != 0 ) {
+                m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( NOTIFIER_SLOT, [&] {
+                    state = word.load( memory_order_acquire );
+                    return ( state & ( NOTIFIED | TERMINATING ) ) != NOTIFIED;
+                } ) );
+                continue;
+            }
+            m_sync_counters.markNotify();
+            if ( word.compare_exchange_weak( state, ( state & ~SLEEPING ) | NOTIFIED,
+                                             memory_order_acq_rel, memory_order_acquire ) ) {
+                break;
+            }
+        }
+        if ( ( state & SLEEPING ) != 0 ) {
+            m_state.wakeOne();
         }
     }
 
-    ~WaitNotifyMultipleWaiters(){
-        terminate();
-        for ( int i = 0; i < m_num_waiters; i++ ) {
-            delete m_cond_var_flags[i];
+    /**
+     * @brief waits until the notifier calls notify().
+     */
+    inline void wait() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifySingleFutex::wait" );
+
+        auto& word = m_state.word();
+
+        uint32_t state  = 0;
+        bool     parked = false;
+
+        m_wait_policy.spinUntil( m_sync_counters.countSpins( WAITER_SLOT, [&] {
+            state = word.load( memory_order_acquire );
+            return ( state & ( NOTIFIED | TERMINATING ) ) != 0;
+        } ) );
+
+        while ( ( state & TERMINATING ) == 0 ) {
+
+            if ( ( state & NOTIFIED ) != 0 ) {
+                word.fetch_and( ~NOTIFIED, memory_order_acq_rel );
+                m_sync_counters.addWakeup( WAITER_SLOT );
+                return;
+            }
+            if ( ( state & SLEEPING ) == 0 ) {
+                if ( !word.compare_exchange_weak( state, state | SLEEPING,
+                                                  memory_order_acq_rel, memory_order_acquire ) ) {
+                    continue;
+                }
+                state |= SLEEPING;
+            }
+            THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+            m_sync_counters.addPark( WAITER_SLOT, parked );
+            parked = true;
+            m_state.waitWhileEqual( state );
+            state = word.load( memory_order_acquire );
         }
     }
+};
 
-    /** 
-     * @brief lets the waiters know that they should terminate the thread execution.
+
+/**
+ * Wait & notification mechanism for a single waiter & a single notifier.
+ * The backend is selected at compile time. Define THREAD_SYNCHRONIZER_USE_FUTEX
+ * before including this file to use WaitNotifySingleFutex.
+ */
+#ifdef THREAD_SYNCHRONIZER_USE_FUTEX
+using WaitNotifySingle = WaitNotifySingleFutex;
+#else
+using WaitNotifySingle = WaitNotifySingleCondVar;
+#endif
+
+
+/**
+ * Wait & notification mechanism for a single waiter & a single notifier that counts
+ * the notifications, i.e., a bounded counting semaphore on AtomicWaitWord.
+ * Unlike WaitNotifySingle, which holds at most one notification, the notifier can run
+ * ahead of the waiter by up to max_pending notifications before notify() blocks.
+ * It is the link between the stages of a pipeline with more than one item in flight.
+ */
+class WaitNotifyCounting {
+
+    static constexpr uint32_t SLEEPING    = 0x1;
+    static constexpr uint32_t TERMINATING = 0x2;
+    static constexpr uint32_t ONE         = 0x4; // the count is in the bits above
+
+    static constexpr int WAITER_SLOT   = 0;
+    static constexpr int NOTIFIER_SLOT = 1;
+
+    AtomicWaitWord     m_state;
+
+    const uint32_t     m_max_pending;
+    const WaitPolicy   m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    static inline uint32_t count( const uint32_t state ) { return state / ONE; }
+
+  public:
+    /**
+     * @param max_pending   (in): max number of the notifications not consumed by the waiter yet.
+     * @param initial_count (in): number of the notifications at start, e.g. the credits of a pipeline.
+     * @param wait_policy   (in): spin-then-park policy for wait() and notify().
+     */
+    WaitNotifyCounting( const int max_pending, const int initial_count = 0, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_state         ( initial_count * ONE )
+        ,m_max_pending   ( max_pending )
+        ,m_wait_policy   ( wait_policy )
+        ,m_sync_counters ( 2 )
+        {;}
+
+    ~WaitNotifyCounting(){
+        terminate();
+    }
+
+    /** 
+     * @brief lets the waiter know that it should terminate the thread execution.
+     */
+    void terminate() {
+
+        m_sync_counters.markNotify();
+        m_state.word().fetch_or( TERMINATING, memory_order_acq_rel );
+        m_state.wakeAll();
+    }
+
+    /**
+     * @brief the waiter can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return ( m_state.word().load( memory_order_acquire ) & TERMINATING ) != 0;
+    }
+
+    /**
+     * @brief hot-path counters. Slot 0 is the waiter and slot 1 is the notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /**
+     * @brief number of the notifications not consumed yet.
+     */
+    int numPending() {
+        return count( m_state.word().load( memory_order_acquire ) );
+    }
+
+    /** 
+     * @brief adds one notification.
+     *        It waits in a spin lock if max_pending notifications have not been consumed yet.
+     */
+    inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyCounting::notify" );
+
+        auto& word = m_state.word();
+
+        uint32_t state = word.load( memory_order_acquire );
+
+        while ( true ) {
+
+            if ( ( state & TERMINATING ) != 0 ) {
+                return;
+            }
+            if ( count( state ) >= m_max_pending ) {
+                m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( NOTIFIER_SLOT, [&] {
+                    state = word.load( memory_order_acquire );
+                    return ( state & TERMINATING ) != 0 || count( state ) < m_max_pending;
+                } ) );
+                continue;
+            }
+            m_sync_counters.markNotify();
+            if ( word.compare_exchange_weak( state, ( state & ~SLEEPING ) + ONE,
+                                             memory_order_acq_rel, memory_order_acquire ) ) {
+                break;
+            }
+        }
+        if ( ( state & SLEEPING ) != 0 ) {
+            m_state.wakeOne();
+        }
+    }
+
+    /**
+     * @brief waits until a notification is available, and consumes it.
+     */
+    inline void wait() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyCounting::wait" );
+
+        auto& word = m_state.word();
+
+        uint32_t state  = 0;
+        bool     parked = false;
+
+        m_wait_policy.spinUntil( m_sync_counters.countSpins( WAITER_SLOT, [&] {
+            state = word.load( memory_order_acquire );
+            return ( state & TERMINATING ) != 0 || count( state ) > 0;
+        } ) );
+
+        while ( ( state & TERMINATING ) == 0 ) {
+
+            if ( count( state ) > 0 ) {
+                word.fetch_sub( ONE, memory_order_acq_rel );
+                m_sync_counters.addWakeup( WAITER_SLOT );
+                return;
+            }
+            if ( ( state & SLEEPING ) == 0 ) {
+                if ( !word.compare_exchange_weak( state, state | SLEEPING,
+                                                  memory_order_acq_rel, memory_order_acquire ) ) {
+                    continue;
+                }
+                state |= SLEEPING;
+            }
+            THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+            m_sync_counters.addPark( WAITER_SLOT, parked );
+            parked = true;
+            m_state.waitWhileEqual( state );
+            state = word.load( memory_order_acquire );
+        }
+    }
+};
+
+
+/**
+ * Wait & notification mechanism for multiple waiters & a single notifier.
+ * It is mainly used with WaitNotifyMultipleNotifiers to form a parallel
+ * execution of a thread group.
+ */
+class WaitNotifyMultipleWaiters {
+
+    mutex                                     m_mutex;
+    condition_variable                        m_cond_var;
+    vector< CacheLineAligned< atomic_bool > > m_cond_var_flags;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_waiting;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_waiters;
+    int                  m_num_active;   // thread_ids 0 ... m_num_active - 1 are woken up.
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+  public:
+
+    /**
+     * @param num_waiters (in): number of waiters must be fixed at the construction
+     * @param wait_policy (in): spin-then-park policy for wait() and notify().
+     */
+    WaitNotifyMultipleWaiters( const int num_waiters, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_cond_var_flags(num_waiters)
+        ,m_num_waiting   (0)
+        ,m_terminating   (false)
+        ,m_num_waiters   (num_waiters)
+        ,m_num_active    (num_waiters)
+        ,m_wait_policy   (wait_policy)
+        ,m_sync_counters (num_waiters + 1)
+    {
+        for ( auto& f : m_cond_var_flags ) {
+            f.m_value.store( false,  memory_order_release );
+        }
+    }
+
+    ~WaitNotifyMultipleWaiters(){
+        terminate();
+    }
+
+    /** 
+     * @brief lets the waiters know that they should terminate the thread execution.
+     */
+    void terminate() {
+
+        unique_lock<mutex> lock( m_mutex, defer_lock );
+        lock.lock();
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+        lock.unlock();
+        m_cond_var.notify_all();
+    }
+
+    /**
+     * @brief the waiters can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is the waiter of thread_id i, and slot num_waiters is the notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+
+    /** 
+     * @brief give the waiting threads a go ahead.
+     *        It also waits in a spin lock if all the waiters are not yet in wait().
+     */
+    inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyMultipleWaiters::notify" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            unique_lock<mutex> lock( m_mutex, defer_lock );
+
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( m_num_waiters,
+                                         [&] { return    m_num_waiting.load( memory_order_acquire ) >= m_num_waiters
+                                                      || m_terminating.load( memory_order_acquire ); } ) );
+            m_sync_counters.lock( m_num_waiters, lock );
+            m_sync_counters.markNotify();
+            // the inactive waiters stay in wait() and hence stay counted.
+            m_num_waiting.fetch_sub( m_num_active, memory_order_acq_rel );
+            for ( int i = 0; i < m_num_active; i++ ) {
+                m_cond_var_flags[i].m_value.store( true,  memory_order_release );
+            }
+            lock.unlock();
+            m_cond_var.notify_all();
+        }
+    }
+
+
+    /**
+     * @brief waits until the notifier calls notify().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_waiters.
+     */
+    inline void wait( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyMultipleWaiters::wait" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            m_num_waiting.fetch_add( 1, memory_order_acq_rel );
+
+            auto notified = [&] { return    m_cond_var_flags[ thread_id ].m_value.load( memory_order_acquire )
+                                         || m_terminating.load( memory_order_acquire ); };
+
+            if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( thread_id, notified ) ) ) {
+
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                unique_lock<mutex> lock( m_mutex, defer_lock );
+                m_sync_counters.lock( thread_id, lock );
+                m_cond_var.wait( lock, m_sync_counters.countParks( thread_id, notified ) );
+                lock.unlock();
+            }
+            m_cond_var_flags[ thread_id ].m_value.store( false, memory_order_release );
+            m_sync_counters.addWakeup( thread_id );
+        }
+    }
+
+    /**
+     * @brief changes the number of the active waiters without reconstructing the object.
+     *        notify() wakes up only thread_ids 0 ... num_active - 1. The others keep calling wait()
+     *        as usual, and stay parked there until they are activated again or terminate() is called.
+     *        Call it from the notifier between notify() calls.
+     *
+     * @param num_active (in): 1 <= num_active <= num_waiters given at the construction. Clamped to this range.
+     */
+    void setNumActive( const int num_active ) { m_num_active = min( max( num_active, 1 ), m_num_waiters ); }
+
+    int numActive() const { return m_num_active; }
+};
+
+
+/**
+ * Wait & notification mechanism for a single waiter & multiple notifiers.
+ * It is mainly used with WaitNotifyMultipleNotifiers to form a parallel
+ * execution of a thread group.
+ */
+class WaitNotifyMultipleNotifiers {
+
+
+    mutex              m_mutex;
+    condition_variable m_cond_var;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_notified;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_waiting;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int          m_num_notifiers;
+    int                m_num_active;     // number of the notifiers wait() waits for.
+
+    const WaitPolicy   m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    ArrivalMonitor*    m_arrival_monitor;
+
+    inline void notifyFrom( const int slot ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyMultipleNotifiers::notify" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            if ( m_arrival_monitor != nullptr && slot < m_num_notifiers ) {
+                m_arrival_monitor->arrive( slot );
+            }
+
+            unique_lock<mutex> lock( m_mutex, defer_lock );
+
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( slot,
+                                         [&] { return    m_waiting.    load( memory_order_acquire )
+                                                      || m_terminating.load( memory_order_acquire ); } ) );
+
+            m_sync_counters.lock( slot, lock );
+
+            m_sync_counters.markNotify();
+            m_num_notified.fetch_add( 1,  memory_order_acq_rel );
+            lock.unlock();
+
+            m_cond_var.notify_one();
+
+        }
+    }
+
+  public:
+
+    /**
+     * @param num_notifiers (in): number of notifiers must be fixed at the construction
+     * @param wait_policy   (in): spin-then-park policy for wait() and notify().
+     */
+    WaitNotifyMultipleNotifiers( const int num_notifiers, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_num_notified    (0)
+        ,m_waiting         (false)
+        ,m_terminating     (false)
+        ,m_num_notifiers   (num_notifiers)
+        ,m_num_active      (num_notifiers)
+        ,m_wait_policy     (wait_policy)
+        ,m_sync_counters   (num_notifiers + 2)
+        ,m_arrival_monitor (nullptr)
+    {;}
+
+
+    ~WaitNotifyMultipleNotifiers(){
+        terminate();
+    }
+
+    /** 
+     * @brief lets the waiter know that they should terminate the thread execution.
+     */
+    void terminate() {
+
+        unique_lock<mutex> lock( m_mutex, defer_lock );
+        lock.lock();
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+        lock.unlock();
+        m_cond_var.notify_one();
+    }
+
+    /**
+     * @brief the waiter can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is the notifier of thread_id i, slot num_notifiers is the waiter,
+     *        and slot num_notifiers + 1 is shared by the notifiers that call notify() without thread_id.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /**
+     * @brief attaches the straggler & stall detector. nullptr to detach.
+     *        Call it before the threads start. See ArrivalMonitor in arrival_monitor.h.
+     *
+     * @param monitor (in): for num_notifiers participants. Only notify( thread_id ) records the arrival,
+     *                      and the waiter completes the phase.
+     */
+    void setArrivalMonitor( ArrivalMonitor* monitor ) {
+
+        m_arrival_monitor = monitor;
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
+
+    /** 
+     * @brief give the waiting threads a go ahead.
+     *        It also waits in a spin lock if the waiter is not yet in wait().
+     */
+    inline void notify() {
+        notifyFrom( m_num_notifiers + 1 );
+    }
+
+    /** 
+     * @brief same as notify().
+     *
+     * @param thread_id (in): It is here for the compatibility with CombiningWaitNotifyMultipleNotifiers.
+     *                        Used only for the counters and the arrival monitor.
+     */
+    inline void notify( const int thread_id ) {
+        notifyFrom( thread_id );
+    }
+
+    /**
+     * @brief waits until all the notifier call notify().
+     */
+    inline void wait() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyMultipleNotifiers::wait" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            m_waiting.store( true, memory_order_release );
+
+            auto all_notified = [&] { return    m_num_notified.load( memory_order_acquire ) == m_num_active
+                                             || m_terminating.load( memory_order_acquire ) ; };
+
+            unique_lock<mutex> lock( m_mutex, defer_lock );
+
+            if ( m_wait_policy.spinUntil( m_sync_counters.countSpins( m_num_notifiers, all_notified ) ) ) {
+                m_sync_counters.lock( m_num_notifiers, lock );
+            }
+            else {
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                m_sync_counters.lock( m_num_notifiers, lock );
+                m_cond_var.wait( lock, m_sync_counters.countParks( m_num_notifiers, all_notified ) );
+            }
+
+            const bool complete_phase = m_arrival_monitor != nullptr && !m_terminating.load( memory_order_acquire );
+
+            m_waiting.     store( false, memory_order_release );
+            m_num_notified.store( 0, memory_order_release );
+
+            lock.unlock();
+
+            // the notifiers do not arrive again before the next round, so the phase can be
+            // closed without the mutex, as the monitor may call the stall handler.
+            if ( complete_phase ) {
+                m_arrival_monitor->completePhase();
+            }
+            m_sync_counters.addWakeup( m_num_notifiers );
+
+        }
+    }
+
+    /**
+     * @brief changes the number of the notifiers wait() waits for without reconstructing the object.
+     *        Only thread_ids 0 ... num_active - 1 are expected to call notify() in each round.
+     *        Call it from the waiter between wait() calls, while no notifier is in notify().
+     *
+     * @param num_active (in): 1 <= num_active <= num_notifiers given at the construction. Clamped to this range.
+     */
+    void setNumActive( const int num_active ) {
+
+        m_num_active = min( max( num_active, 1 ), m_num_notifiers );
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
+
+    int numActive() const { return m_num_active; }
+};
+
+
+/**
+ * Wait & notification mechanism for N waiters & N notifiers.
+ */
+class WaitNotifyNxN {
+
+    mutex                                     m_mutex;
+    condition_variable                        m_cond_var;
+    vector< CacheLineAligned< atomic_bool > > m_cond_var_flags;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_waiting;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_notifying;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_participants;
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+  public:
+
+    /**
+     * @param num_participants (in): number of notifiers/waiters  must be fixed at the construction
+     * @param wait_policy      (in): spin-then-park policy for wait() and notify().
+     */
+    WaitNotifyNxN( const int num_participants, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_cond_var_flags   (num_participants)
+        ,m_num_waiting      (0)
+        ,m_num_notifying    (0)
+        ,m_terminating      (false)
+        ,m_num_participants (num_participants)
+        ,m_wait_policy      (wait_policy)
+        ,m_sync_counters    (num_participants + 1)
+    {
+        for ( auto& f : m_cond_var_flags ) {
+            f.m_value.store( false,  memory_order_release );
+        }
+    }
+
+    ~WaitNotifyNxN(){
+        terminate();
+    }
+
+
+    /** 
+     * @brief give the waiting threads a go ahead.
+     *        It also waits in a spin lock if not al the waiters are yet in wait().
+     */
+    inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyNxN::notify" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            unique_lock<mutex> lock( m_mutex, defer_lock );
+
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( m_num_participants,
+                                         [&] { return    m_num_waiting.load( memory_order_acquire ) >= m_num_participants
+                                                      || m_terminating.load( memory_order_acquire ); } ) );
+            m_sync_counters.lock( m_num_participants, lock );
+            auto v = m_num_notifying.fetch_add( 1, memory_order_acq_rel );
+            if ( v + 1 ==  m_num_participants ) {
+                m_sync_counters.markNotify();
+                THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+                for ( auto& f : m_cond_var_flags ) {
+                    f.m_value.store( true,  memory_order_release );
+                }
+                m_num_notifying.store( 0, memory_order_release );
+                m_num_waiting.  store( 0, memory_order_release );
+                lock.unlock();
+                m_cond_var.notify_all();
+            }
+            else {
+                lock.unlock();
+            }
+        }
+    }
+
+    /**
+     * @brief waits until all the notifier call notify().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     */
+    inline void wait( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyNxN::wait" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            m_num_waiting.fetch_add( 1, memory_order_acq_rel );
+
+            auto notified = [&] { return    m_terminating.load( memory_order_acquire )
+                                         || m_cond_var_flags[ thread_id ].m_value.load( memory_order_acquire ); };
+
+            if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( thread_id, notified ) ) ) {
+
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                unique_lock<mutex> lock( m_mutex, defer_lock );
+                m_sync_counters.lock( thread_id, lock );
+                m_cond_var.wait( lock, m_sync_counters.countParks( thread_id, notified ) );
+                lock.unlock();
+            }
+            m_cond_var_flags[ thread_id ].m_value.store( false, memory_order_release );
+            m_sync_counters.addWakeup( thread_id );
+        }
+    }
+
+    /** 
+     * @brief lets the waiters know that they should terminate the thread execution.
+     */
+    void terminate() {
+
+        unique_lock<mutex> lock( m_mutex, defer_lock );
+        lock.lock();
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+        lock.unlock();
+        m_cond_var.notify_all();
+    }
+
+
+    /**
+     * @brief the waiters can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is the waiter of thread_id i, and slot num_participants
+     *        is shared by the notifiers, as notify() does not take thread_id.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+};
+
+
+/**
+ * Synchronization mechanism among multipel threads running in parallel in a group.
+ * it works as __syncthreads() in CUDA in a block.
+ */
+class WaitNotifyEachOther {
+
+    mutex                                     m_mutex;
+    condition_variable                        m_cond_var;
+    vector< CacheLineAligned< atomic_bool > > m_cond_var_flags;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_is_ready;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_waiting;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_participants;
+    int                  m_num_active;
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    ArrivalMonitor*      m_arrival_monitor;
+
+  public:
+
+    /**
+     * @param num_participants (in): number of threads in the group must be fixed at construction.
+     * @param wait_policy      (in): spin-then-park policy for syncThreads().
+     */
+    WaitNotifyEachOther( const int num_participants, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_cond_var_flags   (num_participants)
+        ,m_is_ready         (false)
+        ,m_num_waiting      (0)
+        ,m_terminating      (false)
+        ,m_num_participants (num_participants)
+        ,m_num_active       (num_participants)
+        ,m_wait_policy      (wait_policy)
+        ,m_sync_counters    (num_participants)
+        ,m_arrival_monitor  (nullptr)
+    {
+        for ( auto& f : m_cond_var_flags ) {
+            f.m_value.store( false,  memory_order_release );
+        }
+        m_is_ready.store( true,  memory_order_release );
+    }
+
+    ~WaitNotifyEachOther(){
+        terminate();
+    }
+
+
+    /**
+     * @brief waits until all the other participating threads calls syncThreads().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     */
+    inline void syncThreads( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WaitNotifyEachOther::syncThreads" );
+
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+
+            if ( m_arrival_monitor != nullptr ) {
+                m_arrival_monitor->arrive( thread_id );
+            }
+
+            unique_lock<mutex> lock( m_mutex, defer_lock );
+
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( thread_id,
+                                         [&] { return    m_is_ready.load( memory_order_acquire ) 
+                                                      || m_terminating.load( memory_order_acquire ); } ) );
+            m_sync_counters.lock( thread_id, lock );
+            auto prev_val = m_num_waiting.fetch_add( 1, memory_order_acq_rel );
+            if ( prev_val == m_num_active - 1 ) {
+
+                // last thread to syncThreads.
+                if ( m_arrival_monitor != nullptr ) {
+                    // the others are all waiting for the release, so the phase can be closed
+                    // without the mutex, as the monitor may call the stall handler.
+                    lock.unlock();
+                    m_arrival_monitor->completePhase();
+                    lock.lock();
+                }
+                m_sync_counters.markNotify();
+                THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+                m_is_ready.store( false, memory_order_release );
+                if ( m_num_waiting.fetch_add( -1, memory_order_acq_rel ) == 1 ) {
+                    // no other thread to leave, i.e., a single active thread.
+                    m_is_ready.store( true, memory_order_release );
+                }
+                for ( int i = 0 ; i < m_num_active ; i++ ) {
+                    if ( i != thread_id ) {
+                        m_cond_var_flags[i].m_value.store( true,  memory_order_release );
+                    }
+                }
+                lock.unlock();
+                m_cond_var.notify_all();
+            }
+            else {
+                lock.unlock();
+
+                auto released = [&] { return    m_terminating.load( memory_order_acquire )
+                                             || m_cond_var_flags[ thread_id ].m_value.load( memory_order_acquire ); };
+
+                if ( m_wait_policy.spinUntil( m_sync_counters.countSpins( thread_id, released ) ) ) {
+                    m_sync_counters.lock( thread_id, lock );
+                }
+                else {
+                    THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                    m_sync_counters.lock( thread_id, lock );
+                    m_cond_var.wait( lock, m_sync_counters.countParks( thread_id, released ) );
+                }
+
+                m_cond_var_flags[ thread_id ].m_value.store( false, memory_order_release );
+
+                auto prev_val_after_wait = m_num_waiting.fetch_add( -1, memory_order_acq_rel );
+
+                if (prev_val_after_wait == 1) {
+
+                    m_is_ready.store( true, memory_order_release );
+                }
+                lock.unlock();
+
+                m_sync_counters.addWakeup( thread_id );
+            }
+        }
+    }
+
+    /** 
+     * @brief lets all the participaint threads know that they should terminate the thread execution.
+     */
+    void terminate() {
+
+        unique_lock<mutex> lock( m_mutex, defer_lock );
+        lock.lock();
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+        lock.unlock();
+        m_cond_var.notify_all();
+    }
+
+    /**
+     * @brief the participating threads can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is thread_id i.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /**
+     * @brief attaches the straggler & stall detector. nullptr to detach.
+     *        Call it before the threads start. See ArrivalMonitor in arrival_monitor.h.
+     *
+     * @param monitor (in): for num_participants participants. The last thread to arrive completes the phase.
+     */
+    void setArrivalMonitor( ArrivalMonitor* monitor ) {
+
+        m_arrival_monitor = monitor;
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
+
+    /**
+     * @brief changes the number of the threads syncThreads() waits for without reconstructing the object.
+     *        Only thread_ids 0 ... num_active - 1 are expected to call syncThreads() after this.
+     *        Call it while no thread is in syncThreads(), e.g. from the master between the dispatches.
+     *
+     * @param num_active (in): 1 <= num_active <= num_participants given at the construction. Clamped to this range.
+     */
+    void setNumActive( const int num_active ) {
+
+        m_num_active = min( max( num_active, 1 ), m_num_participants );
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
+
+    int numActive() const { return m_num_active; }
+};
+
+
+/**
+ * Busy-poll version of WaitNotifyMultipleWaiters for dedicated cores.
+ * It has the same API but never touches a mutex or a condition variable.
+ * The waiters spin on the generation counter with a CPU pause hint only,
+ * and hence each waiter occupies its core at 100%.
+ * Don't use it if the threads outnumber the cores.
+ */
+class SpinWaitNotifyMultipleWaiters {
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_uint m_generation;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_waiting;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_waiters;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+  public:
+
+    /**
+     * @param num_waiters (in): number of waiters must be fixed at the construction
+     */
+    SpinWaitNotifyMultipleWaiters( const int num_waiters )
+        :m_generation    (0)
+        ,m_num_waiting   (0)
+        ,m_terminating   (false)
+        ,m_num_waiters   (num_waiters)
+        ,m_sync_counters (num_waiters + 1)
+        {;}
+
+    ~SpinWaitNotifyMultipleWaiters(){
+        terminate();
+    }
+
+    /** 
+     * @brief lets the waiters know that they should terminate the thread execution.
+     */
+    void terminate() {
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+    }
+
+    /**
+     * @brief the waiters can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is the waiter of thread_id i, and slot num_waiters is the notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /** 
+     * @brief give the waiting threads a go ahead.
+     *        It also spins if all the waiters are not yet in wait().
+     */
+    inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "SpinWaitNotifyMultipleWaiters::notify" );
+
+        while(     m_num_waiting.load( memory_order_acquire ) < m_num_waiters
+               && !m_terminating.load( memory_order_acquire ) ) {
+            m_sync_counters.addSpin( m_num_waiters );
+            WaitPolicy::cpuRelax();
+        }
+        m_sync_counters.markNotify();
+        m_num_waiting.store   ( 0, memory_order_release );
+        m_generation.fetch_add( 1, memory_order_acq_rel );
+    }
+
+    /**
+     * @brief waits in a spin loop until the notifier calls notify().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_waiters.
+     *                        Used only for the counters. It is here for the compatibility with WaitNotifyMultipleWaiters.
+     */
+    inline void wait( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "SpinWaitNotifyMultipleWaiters::wait" );
+
+        const auto generation = m_generation.load( memory_order_acquire );
+
+        m_num_waiting.fetch_add( 1, memory_order_acq_rel );
+
+        while(    m_generation.load( memory_order_acquire ) == generation
+               && !m_terminating.load( memory_order_acquire ) ) {
+            m_sync_counters.addSpin( thread_id );
+            WaitPolicy::cpuRelax();
+        }
+        m_sync_counters.addWakeup( thread_id );
+    }
+};
+
+
+/**
+ * Busy-poll version of WaitNotifyMultipleNotifiers for dedicated cores.
+ * It has the same API but never touches a mutex or a condition variable.
+ * The notifiers do not wait for the waiter. They just count up.
+ */
+class SpinWaitNotifyMultipleNotifiers {
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_notified;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int          m_num_notifiers;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+  public:
+
+    /**
+     * @param num_notifiers (in): number of notifiers must be fixed at the construction
+     */
+    SpinWaitNotifyMultipleNotifiers( const int num_notifiers )
+        :m_num_notified  (0)
+        ,m_terminating   (false)
+        ,m_num_notifiers (num_notifiers)
+        ,m_sync_counters (num_notifiers + 1)
+        {;}
+
+    ~SpinWaitNotifyMultipleNotifiers(){
+        terminate();
+    }
+
+    /** 
+     * @brief lets the waiter know that they should terminate the thread execution.
+     */
+    void terminate() {
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+    }
+
+    /**
+     * @brief the waiter can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot num_notifiers is the waiter. The notifiers do not wait,
+     *        and their slots stay at 0. They are here for the same layout as WaitNotifyMultipleNotifiers.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /** 
+     * @brief lets the waiter know this notifier has finished.
+     */
+    inline void notify() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "SpinWaitNotifyMultipleNotifiers::notify" );
+
+        m_sync_counters.markNotify();
+        m_num_notified.fetch_add( 1, memory_order_acq_rel );
+    }
+
+    /** 
+     * @brief same as notify().
+     *
+     * @param thread_id (in): Not used. It is here for the compatibility with CombiningWaitNotifyMultipleNotifiers.
+     */
+    inline void notify( const int thread_id ) {
+        notify();
+    }
+
+    /**
+     * @brief waits in a spin loop until all the notifier call notify().
+     */
+    inline void wait() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "SpinWaitNotifyMultipleNotifiers::wait" );
+
+        while(    m_num_notified.load( memory_order_acquire ) < m_num_notifiers
+               && !m_terminating.load( memory_order_acquire ) ) {
+            m_sync_counters.addSpin( m_num_notifiers );
+            WaitPolicy::cpuRelax();
+        }
+        m_sync_counters.addWakeup( m_num_notifiers );
+        if ( !m_terminating.load( memory_order_acquire ) ) {
+            m_num_notified.fetch_sub( m_num_notifiers, memory_order_acq_rel );
+        }
+    }
+};
+
+
+/**
+ * Busy-poll version of WaitNotifyEachOther for dedicated cores.
+ * It has the same API but never touches a mutex or a condition variable.
+ * The last thread to arrive resets the counter and advances the generation,
+ * on which the other threads are spinning.
+ */
+class SpinWaitNotifyEachOther {
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_uint m_generation;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_arrived;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_participants;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+  public:
+
+    /**
+     * @param num_participants (in): number of threads in the group must be fixed at construction.
+     */
+    SpinWaitNotifyEachOther( const int num_participants )
+        :m_generation       (0)
+        ,m_num_arrived      (0)
+        ,m_terminating      (false)
+        ,m_num_participants (num_participants)
+        ,m_sync_counters    (num_participants)
+        {;}
+
+    ~SpinWaitNotifyEachOther(){
+        terminate();
+    }
+
+    /**
+     * @brief waits in a spin loop until all the other participating threads calls syncThreads().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     *                        Used only for the counters. It is here for the compatibility with WaitNotifyEachOther.
+     */
+    inline void syncThreads( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "SpinWaitNotifyEachOther::syncThreads" );
+
+        const auto generation = m_generation.load( memory_order_acquire );
+
+        if ( m_num_arrived.fetch_add( 1, memory_order_acq_rel ) == m_num_participants - 1 ) {
+
+            // last thread to syncThreads.
+            m_sync_counters.markNotify();
+            THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+            m_num_arrived.store   ( 0, memory_order_release );
+            m_generation.fetch_add( 1, memory_order_acq_rel );
+        }
+        else {
+            while(    m_generation.load( memory_order_acquire ) == generation
+                   && !m_terminating.load( memory_order_acquire ) ) {
+                m_sync_counters.addSpin( thread_id );
+                WaitPolicy::cpuRelax();
+            }
+            m_sync_counters.addWakeup( thread_id );
+        }
+    }
+
+    /** 
+     * @brief lets all the participaint threads know that they should terminate the thread execution.
+     */
+    void terminate() {
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+    }
+
+    /**
+     * @brief the participating threads can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is thread_id i.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+};
+
+
+/**
+ * Sense-reversing centralized barrier with the same API as WaitNotifyEachOther.
+ * Each thread flips its local sense and decrements the arrival counter.
+ * The last thread to arrive resets the counter and flips the global sense,
+ * which releases the others spinning (and then parking) on it.
+ * No mutex is taken, and the threads of the next phase can arrive while the
+ * threads of the previous phase are still leaving, as they wait for the opposite sense.
+ * A thread sets SLEEPING in the word before it parks, and the last thread clears it
+ * together with the flip, so the futex wake is issued only if someone is parked.
+ */
+class SenseReversingWaitNotifyEachOther {
+
+    static constexpr uint32_t SENSE       = 0x1;
+    static constexpr uint32_t TERMINATING = 0x2;
+    static constexpr uint32_t SLEEPING    = 0x4;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_remaining;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) AtomicWaitWord m_sense;
+
+    vector< CacheLineAligned< uint32_t > > m_local_senses;
+
+    const int            m_num_participants;
+    int                  m_num_active;
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    ArrivalMonitor*      m_arrival_monitor;
+
+  public:
+
+    /**
+     * @param num_participants (in): number of threads in the group must be fixed at construction.
+     * @param wait_policy      (in): spin-then-park policy for syncThreads().
+     */
+    SenseReversingWaitNotifyEachOther( const int num_participants, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_num_remaining    (num_participants)
+        ,m_sense            (0)
+        ,m_local_senses     (num_participants)
+        ,m_num_participants (num_participants)
+        ,m_num_active       (num_participants)
+        ,m_wait_policy      (wait_policy)
+        ,m_sync_counters    (num_participants)
+        ,m_arrival_monitor  (nullptr)
+    {
+        for ( auto& s : m_local_senses ) {
+            s.m_value = 0;
+        }
+    }
+
+    ~SenseReversingWaitNotifyEachOther(){
+        terminate();
+    }
+
+    /**
+     * @brief waits until all the other participating threads calls syncThreads().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     */
+    inline void syncThreads( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "SenseReversingWaitNotifyEachOther::syncThreads" );
+
+        auto& word = m_sense.word();
+
+        if ( ( word.load( memory_order_acquire ) & TERMINATING ) != 0 ) {
+            return;
+        }
+
+        const uint32_t local_sense = m_local_senses[ thread_id ].m_value ^ SENSE;
+        m_local_senses[ thread_id ].m_value = local_sense;
+
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->arrive( thread_id );
+        }
+
+        if ( m_num_remaining.fetch_sub( 1, memory_order_acq_rel ) == 1 ) {
+
+            // last thread to syncThreads.
+            if ( m_arrival_monitor != nullptr ) {
+                m_arrival_monitor->completePhase();
+            }
+            m_sync_counters.markNotify();
+            THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+            m_num_remaining.store( m_num_active, memory_order_relaxed );
+
+            uint32_t state = word.load( memory_order_relaxed );
+            while ( !word.compare_exchange_weak( state, ( state ^ SENSE ) & ~SLEEPING,
+                                                 memory_order_acq_rel, memory_order_relaxed ) ) {;}
+
+            if ( ( state & SLEEPING ) != 0 ) {
+                m_sense.wakeAll();
+            }
+        }
+        else {
+            uint32_t state = 0;
+
+            auto released = [&] {
+                state = word.load( memory_order_acquire );
+                return ( state & SENSE ) == local_sense || ( state & TERMINATING ) != 0;
+            };
+
+            if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( thread_id, released ) ) ) {
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                auto released_after_park = m_sync_counters.countParks( thread_id, released );
+                while ( !released_after_park() ) {
+                    if ( ( state & SLEEPING ) == 0 ) {
+                        // fails if the sense has been flipped meanwhile.
+                        if ( !word.compare_exchange_weak( state, state | SLEEPING,
+                                                          memory_order_acq_rel, memory_order_acquire ) ) {
+                            continue;
+                        }
+                        state |= SLEEPING;
+                    }
+                    m_sense.waitWhileEqual( state );
+                }
+            }
+            m_sync_counters.addWakeup( thread_id );
+        }
+    }
+
+    /** 
+     * @brief lets all the participaint threads know that they should terminate the thread execution.
+     */
+    void terminate() {
+        m_sync_counters.markNotify();
+        m_sense.word().fetch_or( TERMINATING, memory_order_acq_rel );
+        m_sense.wakeAll();
+    }
+
+    /**
+     * @brief the participating threads can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return ( m_sense.word().load( memory_order_acquire ) & TERMINATING ) != 0;
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is thread_id i.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
+    /**
+     * @brief attaches the straggler & stall detector. nullptr to detach.
+     *        Call it before the threads start. See ArrivalMonitor in arrival_monitor.h.
+     *
+     * @param monitor (in): for num_participants participants. The last thread to arrive completes the phase.
+     */
+    void setArrivalMonitor( ArrivalMonitor* monitor ) {
+
+        m_arrival_monitor = monitor;
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
+
+    /**
+     * @brief changes the number of the threads syncThreads() waits for without reconstructing the object.
+     *        Only thread_ids 0 ... num_active - 1 are expected to call syncThreads() after this.
+     *        Call it while no thread is in syncThreads(), e.g. from the master between the dispatches.
+     *
+     * @param num_active (in): 1 <= num_active <= num_participants given at the construction. Clamped to this range.
+     */
+    void setNumActive( const int num_active ) {
+
+        m_num_active = min( max( num_active, 1 ), m_num_participants );
+        m_num_remaining.store( m_num_active, memory_order_release );
+
+        // the threads that were inactive have missed the flips of the global sense.
+        const uint32_t sense = m_sense.word().load( memory_order_acquire ) & SENSE;
+        for ( auto& s : m_local_senses ) {
+            s.m_value = sense;
+        }
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
+
+    int numActive() const { return m_num_active; }
+};
+
+
+/**
+ * Dissemination barrier with the same API as WaitNotifyEachOther.
+ * It takes ceil(log2(N)) rounds. In round k, thread i signals thread (i + 2^k) mod N
+ * and waits for the signal from thread (i - 2^k) mod N.
+ * There is no shared counter. Each flag has exactly one writer and one reader and
+ * lives on its own cache line. A flag holds the phase number of the last signal,
+ * so it never has to be reset.
+ * The threads spin with the pause & backoff of WaitPolicy, but never park.
+ */
+class DisseminationWaitNotifyEachOther {
+
+    vector< CacheLineAligned< atomic_uint64_t > > m_flags;  // [ thread_id * m_num_rounds + round ]
+    vector< CacheLineAligned< uint64_t > >        m_phases; // [ thread_id ]
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_participants;
+    const int            m_num_rounds;
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    static int numRounds( const int num_participants ) {
+        int rounds = 0;
+        while ( ( 1 << rounds ) < num_participants ) {
+            rounds++;
+        }
+        return rounds;
+    }
+
+  public:
+
+    /**
+     * @param num_participants (in): number of threads in the group must be fixed at construction.
+     * @param wait_policy      (in): spin & backoff policy for syncThreads().
+     */
+    DisseminationWaitNotifyEachOther( const int num_participants, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_flags            ( num_participants * numRounds( num_participants ) )
+        ,m_phases           ( num_participants )
+        ,m_terminating      ( false )
+        ,m_num_participants ( num_participants )
+        ,m_num_rounds       ( numRounds( num_participants ) )
+        ,m_wait_policy      ( wait_policy )
+        ,m_sync_counters    ( num_participants )
+    {
+        for ( auto& f : m_flags ) {
+            f.m_value.store( 0, memory_order_release );
+        }
+        for ( auto& p : m_phases ) {
+            p.m_value = 0;
+        }
+    }
+
+    ~DisseminationWaitNotifyEachOther(){
+        terminate();
+    }
+
+    /**
+     * @brief waits until all the other participating threads calls syncThreads().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     */
+    inline void syncThreads( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "DisseminationWaitNotifyEachOther::syncThreads" );
+
+        const uint64_t phase = ++( m_phases[ thread_id ].m_value );
+
+        for ( int k = 0; k < m_num_rounds; k++ ) {
+
+            const int partner = ( thread_id + ( 1 << k ) ) % m_num_participants;
+
+            m_flags[ partner * m_num_rounds + k ].m_value.store( phase, memory_order_release );
+
+            auto& own_flag = m_flags[ thread_id * m_num_rounds + k ].m_value;
+
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( thread_id,
+                                         [&] { return    own_flag.load( memory_order_acquire ) >= phase
+                                                       || m_terminating.load( memory_order_acquire ); } ) );
+            if ( m_terminating.load( memory_order_acquire ) ) {
+                return;
+            }
+        }
+    }
+
+    /** 
+     * @brief lets all the participaint threads know that they should terminate the thread execution.
+     */
+    void terminate() {
+        m_terminating.store( true, memory_order_release );
+    }
+
+    /**
+     * @brief the participating threads can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is thread_id i. Only the spins are counted,
+     *        as there is no single release to measure the wakeup latency from.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+};
+
+
+/**
+ * Static tournament (combining tree) barrier with the same API as WaitNotifyEachOther.
+ * In round k, thread i with i mod 2^(k+1) == 0 is the winner and waits for the arrival of
+ * the loser i + 2^k. The loser signals the winner and waits for the wakeup.
+ * Thread 0 is the champion. Once it has won all the rounds, the wakeup goes down the
+ * same tree in the reverse order. It takes ceil(log2(N)) rounds each way.
+ * As in DisseminationWaitNotifyEachOther, each flag has one writer, lives on its own
+ * cache line, and holds the phase number of the last signal.
+ */
+class TournamentWaitNotifyEachOther {
+
+    vector< CacheLineAligned< atomic_uint64_t > > m_arrivals; // [ thread_id * m_num_rounds + round ]
+    vector< CacheLineAligned< atomic_uint64_t > > m_wakeups;  // [ thread_id ]
+    vector< CacheLineAligned< uint64_t > >        m_phases;   // [ thread_id ]
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
+
+    const int            m_num_participants;
+    const int            m_num_rounds;
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    static int numRounds( const int num_participants ) {
+        int rounds = 0;
+        while ( ( 1 << rounds ) < num_participants ) {
+            rounds++;
+        }
+        return rounds;
+    }
+
+    template< class PRED >
+    inline bool spinUntil( const int thread_id, PRED pred ) {
+        m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( thread_id,
+                                     [&] { return pred() || m_terminating.load( memory_order_acquire ); } ) );
+        return !m_terminating.load( memory_order_acquire );
+    }
+
+  public:
+
+    /**
+     * @param num_participants (in): number of threads in the group must be fixed at construction.
+     * @param wait_policy      (in): spin & backoff policy for syncThreads().
+     */
+    TournamentWaitNotifyEachOther( const int num_participants, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_arrivals         ( num_participants * numRounds( num_participants ) )
+        ,m_wakeups          ( num_participants )
+        ,m_phases           ( num_participants )
+        ,m_terminating      ( false )
+        ,m_num_participants ( num_participants )
+        ,m_num_rounds       ( numRounds( num_participants ) )
+        ,m_wait_policy      ( wait_policy )
+        ,m_sync_counters    ( num_participants )
+    {
+        for ( auto& f : m_arrivals ) {
+            f.m_value.store( 0, memory_order_release );
+        }
+        for ( auto& f : m_wakeups ) {
+            f.m_value.store( 0, memory_order_release );
+        }
+        for ( auto& p : m_phases ) {
+            p.m_value = 0;
+        }
+    }
+
+    ~TournamentWaitNotifyEachOther(){
+        terminate();
+    }
+
+    /**
+     * @brief waits until all the other participating threads calls syncThreads().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     */
+    inline void syncThreads( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "TournamentWaitNotifyEachOther::syncThreads" );
+
+        const uint64_t phase = ++( m_phases[ thread_id ].m_value );
+
+        // arrival: go up the tree until this thread loses.
+        int k = 0;
+        for ( ; k < m_num_rounds; k++ ) {
+
+            if ( ( thread_id & ( ( 2 << k ) - 1 ) ) == 0 ) {
+
+                const int loser = thread_id + ( 1 << k );
+                if ( loser < m_num_participants ) {
+                    auto& arrival = m_arrivals[ thread_id * m_num_rounds + k ].m_value;
+                    if ( !spinUntil( thread_id, [&] { return arrival.load( memory_order_acquire ) >= phase; } ) ) {
+                        return;
+                    }
+                }
+            }
+            else {
+                const int winner = thread_id - ( 1 << k );
+                m_arrivals[ winner * m_num_rounds + k ].m_value.store( phase, memory_order_release );
+
+                auto& wakeup = m_wakeups[ thread_id ].m_value;
+                if ( !spinUntil( thread_id, [&] { return wakeup.load( memory_order_acquire ) >= phase; } ) ) {
+                    return;
+                }
+                m_sync_counters.addWakeup( thread_id );
+                break;
+            }
+        }
+
+        if ( k == m_num_rounds ) {
+            // the champion.
+            m_sync_counters.markNotify();
+            THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+        }
+
+        // wakeup: release the losers of the rounds this thread has won.
+        for ( int j = k - 1; j >= 0; j-- ) {
+            const int loser = thread_id + ( 1 << j );
+            if ( loser < m_num_participants ) {
+                m_wakeups[ loser ].m_value.store( phase, memory_order_release );
+            }
+        }
+    }
+
+    /** 
+     * @brief lets all the participaint threads know that they should terminate the thread execution.
+     */
+    void terminate() {
+        m_sync_counters.markNotify();
+        m_terminating.store( true, memory_order_release );
+    }
+
+    /**
+     * @brief the participating threads can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return m_terminating.load( memory_order_acquire );
+    }
+
+    /**
+     * @brief hot-path counters. Slot i is thread_id i. The wakeup latency is measured from
+     *        the champion (thread 0) to the return of each loser.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+};
+
+
+/**
+ * Hierarchical barrier with the same API as WaitNotifyEachOther for multi-socket machines.
+ * The threads are grouped by NUMA node (or shared L3 etc.) Each group has its own
+ * sense-reversing barrier on its own cache lines, and only the last thread to arrive
+ * in each group goes to the global sense-reversing barrier among the groups.
+ * That way only one arrival per group crosses the interconnect.
+ * The threads in a group can also sync only among themselves with syncGroup().
+ * The threads in the same group must call the same sequence of syncThreads() and syncGroup().
+ * As in SenseReversingWaitNotifyEachOther, a thread sets SLEEPING in the sense word before
+ * it parks, and the releaser wakes the word up only if it is set.
+ */
+class HierarchicalWaitNotifyEachOther {
+
+    static constexpr uint32_t SENSE       = 0x1;
+    static constexpr uint32_t TERMINATING = 0x2;
+    static constexpr uint32_t SLEEPING    = 0x4;
+
+    struct alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) Group {
+        atomic_int     m_num_remaining;
+        int            m_num_members;
+        uint32_t       m_global_sense;  // accessed only by the last thread to arrive in the group
+        alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) AtomicWaitWord m_sense;
+    };
+
+    vector< Group >                        m_groups;
+    vector< int >                          m_group_of_thread;
+    vector< CacheLineAligned< uint32_t > > m_local_senses;
+
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int     m_num_remaining_groups;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) AtomicWaitWord m_global_sense;
+
+    const int            m_num_participants;
+
+    const WaitPolicy     m_wait_policy;
+
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
+
+    static vector<int> compactGroups( const vector<int>& group_of_thread ) {
+
+        vector<int> ids;
+        vector<int> compacted;
+
+        for ( const auto g : group_of_thread ) {
+            int i = 0;
+            for ( ; i < (int)ids.size(); i++ ) {
+                if ( ids[i] == g ) {
+                    break;
+                }
+            }
+            if ( i == (int)ids.size() ) {
+                ids.push_back( g );
+            }
+            compacted.push_back( i );
+        }
+        return compacted;
+    }
+
+    static int numGroups( const vector<int>& compacted ) {
+        int num = 0;
+        for ( const auto g : compacted ) {
+            num = max( num, g + 1 );
+        }
+        return num;
+    }
+
+    inline void waitForSense( const int thread_id, AtomicWaitWord& sense_word, const uint32_t sense ) {
+
+        auto&    word  = sense_word.word();
+        uint32_t state = 0;
+
+        auto released = [&] {
+            state = word.load( memory_order_acquire );
+            return ( state & SENSE ) == sense || ( state & TERMINATING ) != 0;
+        };
+
+        if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( thread_id, released ) ) ) {
+            THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+            auto released_after_park = m_sync_counters.countParks( thread_id, released );
+            while ( !released_after_park() ) {
+                if ( ( state & SLEEPING ) == 0 ) {
+                    // fails if the sense has been flipped meanwhile.
+                    if ( !word.compare_exchange_weak( state, state | SLEEPING,
+                                                      memory_order_acq_rel, memory_order_acquire ) ) {
+                        continue;
+                    }
+                    state |= SLEEPING;
+                }
+                sense_word.waitWhileEqual( state );
+            }
+        }
+        m_sync_counters.addWakeup( thread_id );
+    }
+
+    inline void release( AtomicWaitWord& sense_word ) {
+
+        auto&    word  = sense_word.word();
+        uint32_t state = word.load( memory_order_relaxed );
+
+        while ( !word.compare_exchange_weak( state, ( state ^ SENSE ) & ~SLEEPING,
+                                             memory_order_acq_rel, memory_order_relaxed ) ) {;}
+
+        if ( ( state & SLEEPING ) != 0 ) {
+            sense_word.wakeAll();
+        }
+    }
+
+    inline void sync( const int thread_id, const bool global ) {
+
+        if ( isTerminating() ) {
+            return;
+        }
+
+        auto& group = m_groups[ m_group_of_thread[ thread_id ] ];
+
+        const uint32_t local_sense = m_local_senses[ thread_id ].m_value ^ SENSE;
+        m_local_senses[ thread_id ].m_value = local_sense;
+
+        if ( group.m_num_remaining.fetch_sub( 1, memory_order_acq_rel ) == 1 ) {
+
+            // last thread in the group. represents the group at the global level.
+            group.m_num_remaining.store( group.m_num_members, memory_order_relaxed );
+
+            if ( global ) {
+
+                const uint32_t global_sense = group.m_global_sense ^ SENSE;
+                group.m_global_sense = global_sense;
+
+                if ( m_num_remaining_groups.fetch_sub( 1, memory_order_acq_rel ) == 1 ) {
+
+                    m_num_remaining_groups.store( (int)m_groups.size(), memory_order_relaxed );
+                    m_sync_counters.markNotify();
+                    THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+                    release( m_global_sense );
+                }
+                else {
+                    waitForSense( thread_id, m_global_sense, global_sense );
+                }
+            }
+            else {
+                m_sync_counters.markNotify();
+                THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+            }
+            release( group.m_sense );
+        }
+        else {
+            waitForSense( thread_id, group.m_sense, local_sense );
+        }
+    }
+
+  public:
+
+    /**
+     * @param group_of_thread (in): group (e.g. NUMA node) of each thread indexed by thread_id.
+     *                              The size is the number of threads in the group.
+     * @param wait_policy     (in): spin-then-park policy for syncThreads().
+     */
+    HierarchicalWaitNotifyEachOther( const vector<int>& group_of_thread, const WaitPolicy& wait_policy = WaitPolicy() )
+        :m_groups               ( numGroups( compactGroups( group_of_thread ) ) )
+        ,m_group_of_thread      ( compactGroups( group_of_thread ) )
+        ,m_local_senses         ( group_of_thread.size() )
+        ,m_num_remaining_groups ( numGroups( compactGroups( group_of_thread ) ) )
+        ,m_global_sense         ( 0 )
+        ,m_num_participants     ( (int)group_of_thread.size() )
+        ,m_wait_policy          ( wait_policy )
+        ,m_sync_counters        ( (int)group_of_thread.size() )
+    {
+        for ( auto& g : m_groups ) {
+            g.m_num_members  = 0;
+            g.m_global_sense = 0;
+        }
+        for ( const auto g : m_group_of_thread ) {
+            m_groups[ g ].m_num_members++;
+        }
+        for ( auto& g : m_groups ) {
+            g.m_num_remaining.store( g.m_num_members, memory_order_release );
+            g.m_sense.word().store( 0, memory_order_release );
+        }
+        for ( auto& s : m_local_senses ) {
+            s.m_value = 0;
+        }
+    }
+
+    /**
+     * @param num_participants (in): number of threads in the group. The threads are grouped
+     *                               by the NUMA nodes in /sys/devices/system/node assuming
+     *                               thread i runs on CPU i.
+     * @param wait_policy      (in): spin-then-park policy for syncThreads().
+     */
+    HierarchicalWaitNotifyEachOther( const int num_participants, const WaitPolicy& wait_policy = WaitPolicy() )
+        :HierarchicalWaitNotifyEachOther( numaGroupsForThreads( num_participants ), wait_policy )
+        {;}
+
+    ~HierarchicalWaitNotifyEachOther(){
+        terminate();
+    }
+
+    /**
+     * @brief number of the groups at the lower level.
+     */
+    int numGroups() const { return (int)m_groups.size(); }
+
+    /**
+     * @brief waits until all the other participating threads calls syncThreads().
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
      */
-    void terminate() {
+    inline void syncThreads( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "HierarchicalWaitNotifyEachOther::syncThreads" );
 
-        unique_lock<mutex> lock( m_mutex, defer_lock );
-        lock.lock();
-        m_terminating.store( true, memory_order_release );
-        lock.unlock();
-        m_cond_var.notify_all();
+        sync( thread_id, true );
     }
 
     /**
-     * @brief the waiters can check if it should terminate its execution.
+     * @brief waits until all the other threads in the same group calls syncGroup().
+     *        It does not go to the global level.
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
      */
-    bool isTerminating() {
-        return m_terminating.load( memory_order_acquire );
-    }
+    inline void syncGroup( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "HierarchicalWaitNotifyEachOther::syncGroup" );
 
+        sync( thread_id, false );
+    }
 
     /** 
-     * @brief give the waiting threads a go ahead.
-     *        It also waits in a spin lock if all the waiters are not yet in wait().
+     * @brief lets all the participaint threads know that they should terminate the thread execution.
      */
-    inline void notify() {
-        if ( !m_terminating.load( memory_order_acquire ) ) {
+    void terminate() {
 
-            unique_lock<mutex> lock( m_mutex, defer_lock );
+        m_sync_counters.markNotify();
+        m_global_sense.word().fetch_or( TERMINATING, memory_order_acq_rel );
+        m_global_sense.wakeAll();
 
-            while(     m_num_waiting.load( memory_order_acquire) < m_num_waiters
-                   && !m_terminating.load( memory_order_acquire ) ) {;}
-            lock.lock();
-            m_num_waiting.store( 0, memory_order_release );
-            for ( auto* f : m_cond_var_flags ) {
-                f->store( true,  memory_order_release );
-            }
-            lock.unlock();
-            m_cond_var.notify_all();
+        for ( auto& g : m_groups ) {
+            g.m_sense.word().fetch_or( TERMINATING, memory_order_acq_rel );
+            g.m_sense.wakeAll();
         }
     }
 
+    /**
+     * @brief the participating threads can check if it should terminate its execution.
+     */
+    bool isTerminating() {
+        return ( m_global_sense.word().load( memory_order_acquire ) & TERMINATING ) != 0;
+    }
 
     /**
-     * @brief waits until the notifier calls notify().
-     * 
-     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_waiters.
+     * @brief hot-path counters. Slot i is thread_id i. The wakeup latency is measured from
+     *        the release at the top level, i.e., the global release for syncThreads()
+     *        and the group release for syncGroup().
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
      */
-    inline void wait( const int thread_id ) {
-        if ( !m_terminating.load( memory_order_acquire ) ) {
+    SyncCounterSet& counters() { return m_sync_counters; }
+};
 
-            unique_lock<mutex> lock( m_mutex, defer_lock );
-            lock.lock();
 
-            m_num_waiting.fetch_add( 1, memory_order_acq_rel );
+/**
+ * Fan-out version of WaitNotifyMultipleWaiters without the thundering herd.
+ * It has the same API. Each waiter parks on its own word on its own cache line,
+ * and is woken up individually. With fan_out_degree = d, the notifier wakes
+ * waiters 0...d-1, and each woken waiter i wakes up d*(i+1)...d*(i+1)+d-1 before
+ * it returns from wait(). The wakeups are spread over the waiters in a d-ary tree
+ * instead of N waiters serializing on one mutex after notify_all().
+ * With fan_out_degree <= 0, the notifier wakes up all the waiters by itself.
+ */
+class WakeTreeWaitNotifyMultipleWaiters {
 
-            m_cond_var.wait( lock, [&] { return    m_cond_var_flags[ thread_id ]->load( memory_order_acquire )
-                                                || m_terminating.load( memory_order_acquire ); } );
+    vector< CacheLineAligned< AtomicWaitWord > > m_generations; // [ thread_id ]
 
-            m_cond_var_flags[ thread_id ]->store( false, memory_order_release );
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_int  m_num_waiting;
 
-            lock.unlock();
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool m_terminating;
 
-        }
-    }
-};
+    const int            m_num_waiters;
+    int                  m_num_active;   // thread_ids 0 ... m_num_active - 1 are woken up.
+    const int            m_fan_out_degree;
 
+    const WaitPolicy     m_wait_policy;
 
-/**
- * Wait & notification mechanism for a single waiter & multiple notifiers.
- * It is mainly used with WaitNotifyMultipleNotifiers to form a parallel
- * execution of a thread group.
- */
-class WaitNotifyMultipleNotifiers {
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
 
+    inline void wake( const int thread_id ) {
+        auto& generation = m_generations[ thread_id ].m_value;
+        generation.word().fetch_add( 1, memory_order_acq_rel );
+        generation.wakeOne();
+    }
 
-    mutex              m_mutex;
-    condition_variable m_cond_var;
-    atomic_int         m_num_notified;
-    atomic_bool        m_waiting;
+    /**
+     * @brief wakes up the children of the given node in the tree. -1 is the notifier at the root.
+     */
+    inline void wakeChildren( const int thread_id ) {
 
-    atomic_bool        m_terminating;
+        if ( m_fan_out_degree <= 0 ) {
+            if ( thread_id == -1 ) {
+                for ( int i = 0; i < m_num_active; i++ ) {
+                    wake( i );
+                }
+            }
+            return;
+        }
+        const int first = m_fan_out_degree * ( thread_id + 1 );
+        const int last  = min( first + m_fan_out_degree, m_num_active );
 
-    const int          m_num_notifiers;
+        for ( int i = first; i < last; i++ ) {
+            wake( i );
+        }
+    }
 
   public:
 
     /**
-     * @param num_notifiers (in): number of notifiers must be fixed at the construction
+     * @param num_waiters    (in): number of waiters must be fixed at the construction
+     * @param fan_out_degree (in): number of waiters each thread wakes up. <= 0 for the notifier to wake all.
+     * @param wait_policy    (in): spin-then-park policy for wait() and notify().
      */
-    WaitNotifyMultipleNotifiers( const int num_notifiers )
-        :m_num_notified  (0)
-        ,m_waiting       (false)
+    WakeTreeWaitNotifyMultipleWaiters( const int         num_waiters,
+                                       const int         fan_out_degree = 2,
+                                       const WaitPolicy& wait_policy    = WaitPolicy() )
+        :m_generations   (num_waiters)
+        ,m_num_waiting   (0)
         ,m_terminating   (false)
-        ,m_num_notifiers (num_notifiers)
-    {;}
-
+        ,m_num_waiters   (num_waiters)
+        ,m_num_active    (num_waiters)
+        ,m_fan_out_degree(fan_out_degree)
+        ,m_wait_policy   (wait_policy)
+        ,m_sync_counters (num_waiters + 1)
+        {;}
 
-    ~WaitNotifyMultipleNotifiers(){
+    ~WakeTreeWaitNotifyMultipleWaiters(){
         terminate();
     }
 
     /** 
-     * @brief lets the waiter know that they should terminate the thread execution.
+     * @brief lets the waiters know that they should terminate the thread execution.
      */
     void terminate() {
 
-        unique_lock<mutex> lock( m_mutex, defer_lock );
-        lock.lock();
+        m_sync_counters.markNotify();
         m_terminating.store( true, memory_order_release );
-        lock.unlock();
-        m_cond_var.notify_one();
+
+        for ( auto& g : m_generations ) {
+            g.m_value.word().fetch_add( 1, memory_order_acq_rel );
+            g.m_value.wakeAll();
+        }
     }
 
     /**
-     * @brief the waiter can check if it should terminate its execution.
+     * @brief the waiters can check if it should terminate its execution.
      */
     bool isTerminating() {
         return m_terminating.load( memory_order_acquire );
     }
 
+    /**
+     * @brief hot-path counters. Slot i is the waiter of thread_id i, and slot num_waiters is the notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
+
     /** 
      * @brief give the waiting threads a go ahead.
-     *        It also waits in a spin lock if the waiter is not yet in wait().
+     *        It also waits in a spin lock if all the waiters are not yet in wait().
      */
     inline void notify() {
-        if ( !m_terminating.load( memory_order_acquire ) ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WakeTreeWaitNotifyMultipleWaiters::notify" );
 
-            unique_lock<mutex> lock( m_mutex, defer_lock );
-
-            while(    !m_waiting.    load( memory_order_acquire )
-                   && !m_terminating.load( memory_order_acquire ) ) {;}
-
-            lock.lock();       
+        if ( !m_terminating.load( memory_order_acquire ) ) {
 
-            m_num_notified.fetch_add( 1,  memory_order_acq_rel );
-            lock.unlock();
+            m_wait_policy.busyWaitUntil( m_sync_counters.countSpins( m_num_waiters,
+                                         [&] { return    m_num_waiting.load( memory_order_acquire ) >= m_num_waiters
+                                                       || m_terminating.load( memory_order_acquire ); } ) );
+            // the inactive waiters stay in wait() and hence stay counted.
+            m_num_waiting.fetch_sub( m_num_active, memory_order_acq_rel );
 
-            m_cond_var.notify_one();
+            m_sync_counters.markNotify();
 
+            wakeChildren( -1 );
         }
     }
 
     /**
-     * @brief waits until all the notifier call notify().
+     * @brief waits until the notifier or the parent in the tree wakes it up,
+     *        and then wakes up its children in the tree.
+     * 
+     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_waiters.
      */
-    inline void wait() {
+    inline void wait( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "WakeTreeWaitNotifyMultipleWaiters::wait" );
 
         if ( !m_terminating.load( memory_order_acquire ) ) {
 
-            unique_lock<mutex> lock( m_mutex, defer_lock );
-
-            lock.lock();
-            m_waiting.store( true, memory_order_release );
-
-            m_cond_var.wait( lock, [&] { return    m_num_notified.load( memory_order_acquire ) == m_num_notifiers
-                                                || m_terminating.load( memory_order_acquire ) ; } );
+            auto&          generation_word = m_generations[ thread_id ].m_value;
+            const uint32_t generation      = generation_word.word().load( memory_order_acquire );
 
-            m_waiting.     store( false, memory_order_release );
-            m_num_notified.store( 0, memory_order_release );
+            m_num_waiting.fetch_add( 1, memory_order_acq_rel );
 
-            lock.unlock();
+            auto woken = [&] { return generation_word.word().load( memory_order_acquire ) != generation; };
 
+            if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( thread_id, woken ) ) ) {
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                auto woken_after_park = m_sync_counters.countParks( thread_id, woken );
+                while ( !woken_after_park() ) {
+                    generation_word.waitWhileEqual( generation );
+                }
+            }
+            m_sync_counters.addWakeup( thread_id );
+            if ( !m_terminating.load( memory_order_acquire ) ) {
+                wakeChildren( thread_id );
+            }
         }
     }
+
+    /**
+     * @brief changes the number of the active waiters without reconstructing the object.
+     *        notify() wakes up only thread_ids 0 ... num_active - 1. The others keep calling wait()
+     *        as usual, and stay parked there until they are activated again or terminate() is called.
+     *        The active waiters form the top of the tree, so no inactive waiter is on the wake-up path.
+     *        Call it from the notifier between notify() calls.
+     *
+     * @param num_active (in): 1 <= num_active <= num_waiters given at the construction. Clamped to this range.
+     */
+    void setNumActive( const int num_active ) { m_num_active = min( max( num_active, 1 ), m_num_waiters ); }
+
+    int numActive() const { return m_num_active; }
 };
 
 
 /**
- * Wait & notification mechanism for N waiters & N notifiers.
+ * Mutex-free fan-in for a single waiter & multiple notifiers.
+ * The notifiers only decrement a counter on its own cache line, and only the last
+ * one to arrive wakes up the waiter through AtomicWaitWord. The notifiers do not
+ * wait for the waiter to be in wait().
+ * With fan_in_degree = d > 0, the counters form a combining tree: the notifiers
+ * are grouped by d into leaf counters, the last arriver at each counter goes up to
+ * the parent counter, and the last arriver at the root wakes up the waiter.
+ * With fan_in_degree <= 0, there is a single counter.
+ * The notifiers must call notify(thread_id) instead of notify().
  */
-class WaitNotifyNxN {
+class CombiningWaitNotifyMultipleNotifiers {
 
-    mutex                m_mutex;
-    condition_variable   m_cond_var;
-    vector<atomic_bool*> m_cond_var_flags;
-    atomic_int           m_num_waiting;
-    atomic_int           m_num_notifying;
+    struct alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) Counter {
+        atomic_int m_num_remaining;
+        int        m_num_children;
+        int        m_parent;       // -1 for the root.
+    };
 
-    atomic_bool          m_terminating;
+    vector< Counter >    m_counters;   // leaves first, and the root at the end.
 
-    const int            m_num_participants;
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) AtomicWaitWord m_done;
 
-  public:
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic_bool    m_terminating;
 
-    /**
-     * @param num_participants (in): number of notifiers/waiters  must be fixed at the construction
-     */
-    WaitNotifyNxN( const int num_participants )
-        :m_num_waiting      (0)
-        ,m_num_notifying    (0)
-        ,m_terminating      (false)
-        ,m_num_participants (num_participants)
-    {
-        for ( int i = 0; i < m_num_participants; i++ ) {
+    uint32_t             m_generation; // accessed only by the waiter.
 
-            m_cond_var_flags.emplace_back( new atomic_bool() );
-        }
+    const int            m_num_notifiers;
+    int                  m_num_active;
+    const int            m_fan_in_degree;
 
-        for ( int i = 0; i < m_num_participants; i++ ) {
+    const WaitPolicy     m_wait_policy;
 
-            m_cond_var_flags[i]->store( false,  memory_order_release );
-        }
-    }
+    [[no_unique_address]] SyncCounterSet m_sync_counters;
 
-    ~WaitNotifyNxN(){
-        terminate();
-        for ( int i = 0; i < m_num_participants; i++ ) {
-            delete m_cond_var_flags[i];
+    ArrivalMonitor*      m_arrival_monitor;
+
+    static int numCounters( const int num_notifiers, const int fan_in_degree ) {
+
+        if ( fan_in_degree <= 1 || fan_in_degree >= num_notifiers ) {
+            return 1;
         }
+        int total = 0;
+        int width = num_notifiers;
+        do {
+            width  = ( width + fan_in_degree - 1 ) / fan_in_degree;
+            total += width;
+        } while ( width > 1 );
+
+        return total;
     }
 
-
-    /** 
-     * @brief give the waiting threads a go ahead.
-     *        It also waits in a spin lock if not al the waiters are yet in wait().
+    /**
+     * @brief sets up the tree for all the notifiers, and the counts for the active ones.
+     *        The active notifiers are the first m_num_active, and hence at each level
+     *        the counters with at least one active child are the first ones.
      */
-    inline void notify() {
-        if ( !m_terminating.load( memory_order_acquire ) ) {
+    void buildTree() {
 
-            unique_lock<mutex> lock( m_mutex, defer_lock );
+        const int degree = ( m_counters.size() == 1 ) ? m_num_notifiers : m_fan_in_degree;
 
-            while(     m_num_waiting.load( memory_order_acquire ) < m_num_participants
-                   && !m_terminating.load( memory_order_acquire ) ){;}
-            lock.lock();       
-            auto v = m_num_notifying.fetch_add( 1, memory_order_acq_rel );
-            if ( v + 1 ==  m_num_participants ) {
-                for ( auto* f : m_cond_var_flags ) {
-                    f->store( true,  memory_order_release );
-                }
-                m_num_notifying.store( 0, memory_order_release );
-                m_num_waiting.  store( 0, memory_order_release );
-                lock.unlock();
-                m_cond_var.notify_all();
+        int begin        = 0;                // first counter of the current level
+        int width        = m_num_notifiers;  // number of the children at the current level
+        int active_width = m_num_active;     // number of the active children at the current level
+
+        while ( true ) {
+
+            const int num_nodes = ( width + degree - 1 ) / degree;
+
+            for ( int i = 0; i < num_nodes; i++ ) {
+                auto& c = m_counters[ begin + i ];
+                c.m_num_children = max( 0, min( degree, active_width - i * degree ) );
+                c.m_parent       = ( num_nodes == 1 ) ? -1 : begin + num_nodes + i / degree;
+                c.m_num_remaining.store( c.m_num_children, memory_order_release );
             }
-            else {
-                lock.unlock();
+            if ( num_nodes == 1 ) {
+                break;
             }
+            begin        += num_nodes;
+            width         = num_nodes;
+            active_width  = ( active_width + degree - 1 ) / degree;
         }
     }
 
+  public:
+
     /**
-     * @brief waits until all the notifier call notify().
-     * 
-     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     * @param num_notifiers (in): number of notifiers must be fixed at the construction
+     * @param fan_in_degree (in): number of children per counter in the combining tree. <= 0 for a single counter.
+     * @param wait_policy   (in): spin-then-park policy for wait().
      */
-    inline void wait( const int thread_id ) {
-        if ( !m_terminating.load( memory_order_acquire ) ) {
-
-            unique_lock<mutex> lock( m_mutex, defer_lock );
-            lock.lock();
+    CombiningWaitNotifyMultipleNotifiers( const int         num_notifiers,
+                                          const int         fan_in_degree = 0,
+                                          const WaitPolicy& wait_policy   = WaitPolicy() )
+        :m_counters        ( numCounters( num_notifiers, fan_in_degree ) )
+        ,m_done            ( 0 )
+        ,m_terminating     ( false )
+        ,m_generation      ( 0 )
+        ,m_num_notifiers   ( num_notifiers )
+        ,m_num_active      ( num_notifiers )
+        ,m_fan_in_degree   ( fan_in_degree )
+        ,m_wait_policy     ( wait_policy )
+        ,m_sync_counters   ( num_notifiers + 1 )
+        ,m_arrival_monitor ( nullptr )
+    {
+        buildTree();
+    }
 
-            m_num_waiting.fetch_add( 1, memory_order_acq_rel );
-            m_cond_var.wait( lock, [&] { return    m_terminating.load( memory_order_acquire )
-                                                || m_cond_var_flags[ thread_id ]->load( memory_order_acquire ); } );
-            m_cond_var_flags[ thread_id ]->store( false, memory_order_release );
-            lock.unlock();
-        }
+    ~CombiningWaitNotifyMultipleNotifiers(){
+        terminate();
     }
 
     /** 
-     * @brief lets the waiters know that they should terminate the thread execution.
+     * @brief lets the waiter know that they should terminate the thread execution.
      */
     void terminate() {
-
-        unique_lock<mutex> lock( m_mutex, defer_lock );
-        lock.lock();
+        m_sync_counters.markNotify();
         m_terminating.store( true, memory_order_release );
-        lock.unlock();
-        m_cond_var.notify_all();
+        m_done.word().fetch_add( 1, memory_order_acq_rel );
+        m_done.wakeAll();
     }
 
-
     /**
-     * @brief the waiters can check if it should terminate its execution.
+     * @brief the waiter can check if it should terminate its execution.
      */
     bool isTerminating() {
         return m_terminating.load( memory_order_acquire );
     }
-};
 
+    /**
+     * @brief hot-path counters. Slot num_notifiers is the waiter. The notifiers do not wait,
+     *        and their slots stay at 0. The wakeup latency is measured from the last notifier.
+     *        Empty unless THREAD_SYNCHRONIZER_ENABLE_COUNTERS is defined.
+     */
+    SyncCounterSet& counters() { return m_sync_counters; }
 
-/**
- * Synchronization mechanism among multipel threads running in parallel in a group.
- * it works as __syncthreads() in CUDA in a block.
- */
-class WaitNotifyEachOther {
+    /**
+     * @brief attaches the straggler & stall detector. nullptr to detach.
+     *        Call it before the threads start. See ArrivalMonitor in arrival_monitor.h.
+     *
+     * @param monitor (in): for num_notifiers participants. The last notifier to arrive completes the phase.
+     */
+    void setArrivalMonitor( ArrivalMonitor* monitor ) {
 
-    mutex                m_mutex;
-    condition_variable   m_cond_var;
-    vector<atomic_bool*> m_cond_var_flags;
-    atomic_bool          m_is_ready;
-    atomic_int           m_num_waiting;
+        m_arrival_monitor = monitor;
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
+    }
 
-    atomic_bool          m_terminating;
+    /** 
+     * @brief lets the waiter know this notifier has finished.
+     *        Only the last notifier to arrive wakes up the waiter.
+     *
+     * @param thread_id (in): the number that uniquely identifies the notifier. 0 <= thread_id < m_num_notifiers.
+     */
+    inline void notify( const int thread_id ) {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "CombiningWaitNotifyMultipleNotifiers::notify" );
 
-    const int            m_num_participants;
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->arrive( thread_id );
+        }
 
-  public:
+        const int degree = ( m_counters.size() == 1 ) ? m_num_notifiers : m_fan_in_degree;
 
-    /**
-     * @param num_participants (in): number of threads in the group must be fixed at construction.
-     */
-    WaitNotifyEachOther( const int num_participants )
-        :m_is_ready         (false)
-        ,m_num_waiting      (0)
-        ,m_terminating      (false)
-        ,m_num_participants (num_participants)
-    {
-        for ( int i = 0; i < m_num_participants; i++ ) {
+        int index = thread_id / degree;
 
-            m_cond_var_flags.emplace_back( new atomic_bool() );
-        }
+        while ( true ) {
 
-        for ( int i = 0; i < m_num_participants; i++ ) {
+            auto& counter = m_counters[ index ];
 
-            m_cond_var_flags[i]->store( false,  memory_order_release );
+            if ( counter.m_num_remaining.fetch_sub( 1, memory_order_acq_rel ) != 1 ) {
+                return;
+            }
+            // last to arrive at this counter.
+            counter.m_num_remaining.store( counter.m_num_children, memory_order_relaxed );
+
+            if ( counter.m_parent == -1 ) {
+                break;
+            }
+            index = counter.m_parent;
         }
-        m_is_ready.store( true,  memory_order_release );
-    }
 
-    ~WaitNotifyEachOther(){
-        terminate();
-        for ( int i = 0; i < m_num_participants; i++ ) {
-            delete m_cond_var_flags[i];
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->completePhase();
         }
+        m_sync_counters.markNotify();
+        THREAD_SYNCHRONIZER_TRACE_INSTANT( "release" );
+        m_done.word().fetch_add( 1, memory_order_acq_rel );
+        m_done.wakeOne();
     }
 
-
     /**
-     * @brief waits until all the other participating threads calls syncThreads().
-     * 
-     * @param thread_id (in): the number that uniquely identifies the thread. 0 <= thread_id < m_num_participants.
+     * @brief waits until all the notifier call notify().
      */
-    inline void syncThreads( const int thread_id ) {
+    inline void wait() {
+        THREAD_SYNCHRONIZER_TRACE_SCOPE( "CombiningWaitNotifyMultipleNotifiers::wait" );
 
         if ( !m_terminating.load( memory_order_acquire ) ) {
 
-            unique_lock<mutex> lock( m_mutex, defer_lock );
-
-            while(    !m_is_ready.load( memory_order_acquire ) 
-                   && !m_terminating.load( memory_order_acquire ) ){;}
-            lock.lock();
-            auto prev_val = m_num_waiting.fetch_add( 1, memory_order_acq_rel );
-            if ( prev_val == m_num_participants - 1 ) {
-
-                // last thread to syncThreads.
-                m_is_ready.store( false, memory_order_release );
-                m_num_waiting.fetch_add( -1, memory_order_acq_rel );
-                for ( int i = 0 ; i < m_cond_var_flags.size() ; i++ ) {
-                    if ( i != thread_id ) {
-                        m_cond_var_flags[i]->store( true,  memory_order_release );
-                    }
-                }
-                lock.unlock();
-                m_cond_var.notify_all();
-            }
-            else {
-                m_cond_var.wait( lock, [&] { return    m_terminating.load( memory_order_acquire )
-                                                    || m_cond_var_flags[ thread_id ]->load( memory_order_acquire ); } );
-
-                m_cond_var_flags[ thread_id ]->store( false, memory_order_release );
+            const uint32_t generation = m_generation++;
 
-                auto prev_val_after_wait = m_num_waiting.fetch_add( -1, memory_order_acq_rel );
+            auto& word = m_done.word();
 
-                if (prev_val_after_wait == 1) {
+            auto all_notified = [&] { return word.load( memory_order_acquire ) != generation; };
 
-                    m_is_ready.store( true, memory_order_release );
+            if ( !m_wait_policy.spinUntil( m_sync_counters.countSpins( m_num_notifiers, all_notified ) ) ) {
+                THREAD_SYNCHRONIZER_TRACE_SCOPE( "park" );
+                auto all_notified_after_park = m_sync_counters.countParks( m_num_notifiers, all_notified );
+                while ( !all_notified_after_park() ) {
+                    m_done.waitWhileEqual( generation );
                 }
-                lock.unlock();
             }
+            m_sync_counters.addWakeup( m_num_notifiers );
         }
     }
 
-    /** 
-     * @brief lets all the participaint threads know that they should terminate the thread execution.
+    /**
+     * @brief changes the number of the notifiers wait() waits for without reconstructing the object.
+     *        Only thread_ids 0 ... num_active - 1 are expected to call notify() in each round.
+     *        Call it from the waiter between wait() calls, while no notifier is in notify().
+     *
+     * @param num_active (in): 1 <= num_active <= num_notifiers given at the construction. Clamped to this range.
      */
-    void terminate() {
+    void setNumActive( const int num_active ) {
 
-        unique_lock<mutex> lock( m_mutex, defer_lock );
-        lock.lock();
-        m_terminating.store( true, memory_order_release );
-        lock.unlock();
-        m_cond_var.notify_all();
+        m_num_active = min( max( num_active, 1 ), m_num_notifiers );
+        buildTree();
+        if ( m_arrival_monitor != nullptr ) {
+            m_arrival_monitor->setNumActive( m_num_active );
+        }
     }
 
-    /**
-     * @brief the participating threads can check if it should terminate its execution.
-     */
-    bool isTerminating() {
-        return m_terminating.load( memory_order_acquire );
-    }
+    int numActive() const { return m_num_active; }
 };
 
 
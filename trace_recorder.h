@@ -0,0 +1,400 @@
+#ifndef __TRACE_RECORDER_H__
+#define __TRACE_RECORDER_H__
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache_line.h"
+
+using namespace std;
+
+/**
+ * Timeline of the worker activity in the Chrome trace-event format, viewable in
+ * Perfetto (ui.perfetto.dev) or chrome://tracing.
+ *
+ * The synchronizers in thread_synchronizer.h record a duration event for each wait(),
+ * notify() and syncThreads(), and a nested "park" event for each time the thread
+ * actually blocks on the condition variable or the futex.
+ * The hooks are compiled in only if THREAD_SYNCHRONIZER_ENABLE_TRACE is defined before
+ * including thread_synchronizer.h. Otherwise the macros at the bottom expand to nothing.
+ * TraceRecorder itself is always available, and writes an empty trace without the macro.
+ *
+ * Each thread records into its own TraceRing without any lock. The rings are drained
+ * into the recorder off the hot path, by collect(), by the flusher thread started with
+ * startFlusher(), or by writeChromeTrace().
+ */
+
+
+/**
+ * An event in TraceRing.
+ */
+struct TraceEvent {
+
+    uint64_t    m_time_ns; // steady_clock
+    const char* m_name;    // must be a string literal or live until the trace is written
+    const void* m_object;  // the synchronizer that recorded the event
+    char        m_phase;   // 'B': begin, 'E': end, 'i': instant
+};
+
+
+/**
+ * Lock-free ring of the events for a single producer (the thread that owns it)
+ * and a single consumer (TraceRecorder under its mutex).
+ * If the ring is full, the new events are dropped and counted, so that the producer never waits.
+ * The producer side and the consumer side are on their own cache lines, and so is the ring
+ * as a whole, so that neither the drain nor the neighbouring rings disturb the traced thread.
+ */
+class alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) TraceRing {
+
+    const size_t             m_mask;
+    unique_ptr<TraceEvent[]> m_events;
+
+    // producer side
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic<size_t> m_tail;
+    size_t                                                        m_cached_head;
+    atomic<uint64_t>                                              m_num_dropped;
+
+    // consumer side. Read by the producer only when the ring looks full.
+    alignas( THREAD_SYNCHRONIZER_CACHE_LINE_SIZE ) atomic<size_t> m_head;
+
+    const int                                                     m_tid;
+    string                                                        m_thread_name;
+
+    static size_t roundUpToPowerOf2( const size_t n ) {
+
+        size_t p = 1;
+        while ( p < n ) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+  public:
+
+    /**
+     * @param capacity (in): number of the events. Rounded up to a power of 2.
+     * @param tid      (in): the thread number in the trace.
+     */
+    TraceRing( const size_t capacity, const int tid )
+        :m_mask        ( roundUpToPowerOf2( capacity ) - 1 )
+        ,m_events      ( new TraceEvent[ m_mask + 1 ] )
+        ,m_tail        ( 0 )
+        ,m_cached_head ( 0 )
+        ,m_num_dropped ( 0 )
+        ,m_head        ( 0 )
+        ,m_tid         ( tid )
+        ,m_thread_name ( "thread " + to_string( tid ) )
+        {;}
+
+    int tid() const { return m_tid; }
+
+    const string& threadName() const { return m_thread_name; }
+
+    void setThreadName( const string& name ) { m_thread_name = name; }
+
+    uint64_t numDropped() const { return m_num_dropped.load( memory_order_relaxed ); }
+
+    /**
+     * @brief records an event. Owner thread only.
+     */
+    inline void push( const char phase, const char* name, const void* object ) {
+
+        const size_t tail = m_tail.load( memory_order_relaxed );
+
+        if ( tail - m_cached_head > m_mask ) {
+            m_cached_head = m_head.load( memory_order_acquire );
+            if ( tail - m_cached_head > m_mask ) {
+                m_num_dropped.fetch_add( 1, memory_order_relaxed );
+                return;
+            }
+        }
+        TraceEvent& e = m_events[ tail & m_mask ];
+        e.m_time_ns = chrono::duration_cast< chrono::nanoseconds >( chrono::steady_clock::now().time_since_epoch() ).count();
+        e.m_name    = name;
+        e.m_object  = object;
+        e.m_phase   = phase;
+
+        m_tail.store( tail + 1, memory_order_release );
+    }
+
+    /**
+     * @brief moves the recorded events out to events. Consumer only.
+     */
+    void drain( vector< TraceEvent >& events ) {
+
+        const size_t head = m_head.load( memory_order_relaxed );
+        const size_t tail = m_tail.load( memory_order_acquire );
+
+        for ( size_t i = head; i != tail; i++ ) {
+            events.push_back( m_events[ i & m_mask ] );
+        }
+        m_head.store( tail, memory_order_release );
+    }
+};
+
+
+/**
+ * @brief writes the string escaped for a JSON string literal. Also used by the test harness.
+ */
+static inline void writeJsonEscaped( ostream& os, const string& s ) {
+
+    for ( const char c : s ) {
+        if ( c == '"' || c == '\\' ) {
+            os << '\\';
+        }
+        os << c;
+    }
+}
+
+
+/**
+ * Process-wide collector of the TraceRings. A thread gets its ring on its first event.
+ */
+class TraceRecorder {
+
+    mutex                             m_mutex;
+    vector< unique_ptr< TraceRing > > m_rings;   // [ tid ]. Never freed, as the threads may outlive their ring.
+    vector< vector< TraceEvent > >    m_events;  // [ tid ]. Drained from the rings.
+    size_t                            m_ring_capacity;
+
+    thread                            m_flusher;
+    mutex                             m_flusher_mutex;
+    condition_variable                m_flusher_cond_var;
+    bool                              m_flusher_running;
+
+    TraceRecorder()
+        :m_ring_capacity   ( 1 << 15 )
+        ,m_flusher_running ( false )
+        {;}
+
+    TraceRing* registerThread() {
+
+        lock_guard< mutex > lock( m_mutex );
+
+        m_rings.push_back( make_unique< TraceRing >( m_ring_capacity, (int)m_rings.size() ) );
+        m_events.emplace_back();
+        return m_rings.back().get();
+    }
+
+    void collectLocked() {
+
+        for ( size_t i = 0; i < m_rings.size(); i++ ) {
+            m_rings[i]->drain( m_events[i] );
+        }
+    }
+
+  public:
+
+    ~TraceRecorder() {
+        stopFlusher();
+    }
+
+    static TraceRecorder& instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    /**
+     * @brief the ring of the calling thread.
+     */
+    static inline TraceRing& ring() {
+
+        static thread_local TraceRing* r = instance().registerThread();
+        return *r;
+    }
+
+    /**
+     * @brief records an event on the calling thread.
+     */
+    static inline void record( const char phase, const char* name, const void* object ) {
+        ring().push( phase, name, object );
+    }
+
+    /**
+     * @brief names the calling thread in the trace.
+     */
+    static void setThreadName( const string& name ) {
+
+        TraceRing& r = ring();
+        lock_guard< mutex > lock( instance().m_mutex );
+        r.setThreadName( name );
+    }
+
+    /**
+     * @brief number of the events per thread. Applies to the threads that record their first event after this call.
+     */
+    void setRingCapacity( const size_t capacity ) {
+
+        lock_guard< mutex > lock( m_mutex );
+        m_ring_capacity = capacity;
+    }
+
+    /**
+     * @brief drains all the rings into the recorder.
+     */
+    void collect() {
+
+        lock_guard< mutex > lock( m_mutex );
+        collectLocked();
+    }
+
+    /**
+     * @brief starts a thread that calls collect() periodically, so that the rings do not overflow in a long run.
+     */
+    void startFlusher( const chrono::milliseconds interval = chrono::milliseconds( 10 ) ) {
+
+        lock_guard< mutex > lock( m_flusher_mutex );
+        if ( m_flusher_running ) {
+            return;
+        }
+        m_flusher_running = true;
+
+        m_flusher = thread( [this, interval] {
+
+            unique_lock< mutex > lock( m_flusher_mutex );
+            while ( m_flusher_running ) {
+                m_flusher_cond_var.wait_for( lock, interval );
+                collect();
+            }
+        } );
+    }
+
+    void stopFlusher() {
+
+        {
+            lock_guard< mutex > lock( m_flusher_mutex );
+            if ( !m_flusher_running ) {
+                return;
+            }
+            m_flusher_running = false;
+        }
+        m_flusher_cond_var.notify_one();
+        m_flusher.join();
+    }
+
+    /**
+     * @brief discards all the events recorded so far.
+     */
+    void clear() {
+
+        lock_guard< mutex > lock( m_mutex );
+        collectLocked();
+        for ( auto& events : m_events ) {
+            events.clear();
+        }
+    }
+
+    /**
+     * @brief number of the events dropped as the rings were full.
+     */
+    uint64_t numDropped() {
+
+        lock_guard< mutex > lock( m_mutex );
+        uint64_t total = 0;
+        for ( const auto& r : m_rings ) {
+            total += r->numDropped();
+        }
+        return total;
+    }
+
+    /**
+     * @brief drains the rings and writes all the events in the Chrome trace-event JSON format.
+     *        The timestamps are in microseconds from the first event.
+     *
+     * @param path (in): output file.
+     *
+     * @return false if the file could not be opened.
+     */
+    bool writeChromeTrace( const string& path ) {
+
+        ofstream os( path );
+        if ( !os ) {
+            return false;
+        }
+        lock_guard< mutex > lock( m_mutex );
+        collectLocked();
+
+        uint64_t origin = UINT64_MAX;
+        for ( const auto& events : m_events ) {
+            if ( !events.empty() ) {
+                origin = min( origin, events.front().m_time_ns );
+            }
+        }
+
+        os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+        bool first = true;
+        for ( size_t tid = 0; tid < m_rings.size(); tid++ ) {
+
+            os << ( first ? "\n" : ",\n" );
+            first = false;
+            os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"";
+            writeJsonEscaped( os, m_rings[ tid ]->threadName() );
+            os << "\"}}";
+
+            for ( const auto& e : m_events[ tid ] ) {
+
+                os << ",\n{\"name\":\"";
+                writeJsonEscaped( os, e.m_name );
+                os << "\",\"ph\":\"" << e.m_phase << "\"";
+                if ( e.m_phase == 'i' ) {
+                    os << ",\"s\":\"t\"";
+                }
+                os << ",\"pid\":1,\"tid\":" << tid
+                   << ",\"ts\":" << fixed << setprecision( 3 ) << ( e.m_time_ns - origin ) / 1000.0
+                   << ",\"args\":{\"object\":\"" << e.m_object << "\"}}";
+            }
+        }
+        os << "\n]}\n";
+
+        return (bool)os;
+    }
+};
+
+
+/**
+ * Records a begin event at construction and an end event at destruction.
+ */
+class TraceScope {
+
+    const char* m_name;
+    const void* m_object;
+
+  public:
+    TraceScope( const char* name, const void* object )
+        :m_name   ( name )
+        ,m_object ( object )
+    {
+        TraceRecorder::record( 'B', m_name, m_object );
+    }
+
+    ~TraceScope() {
+        TraceRecorder::record( 'E', m_name, m_object );
+    }
+};
+
+
+#define THREAD_SYNCHRONIZER_TRACE_CONCAT_( a, b ) a##b
+#define THREAD_SYNCHRONIZER_TRACE_CONCAT( a, b ) THREAD_SYNCHRONIZER_TRACE_CONCAT_( a, b )
+
+#ifdef THREAD_SYNCHRONIZER_ENABLE_TRACE
+#define THREAD_SYNCHRONIZER_TRACE_SCOPE( name ) \
+    TraceScope THREAD_SYNCHRONIZER_TRACE_CONCAT( trace_scope_, __LINE__ )( name, this )
+#define THREAD_SYNCHRONIZER_TRACE_INSTANT( name ) TraceRecorder::record( 'i', name, this )
+#define THREAD_SYNCHRONIZER_TRACE_THREAD_NAME( name ) TraceRecorder::setThreadName( name )
+#else
+#define THREAD_SYNCHRONIZER_TRACE_SCOPE( name )
+#define THREAD_SYNCHRONIZER_TRACE_INSTANT( name )
+#define THREAD_SYNCHRONIZER_TRACE_THREAD_NAME( name )
+#endif
+
+#endif /*__TRACE_RECORDER_H__*/